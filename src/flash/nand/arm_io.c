@@ -132,6 +132,15 @@ int arm_nandwrite(struct arm_nand_data *nand, uint8_t *data, int size)
 	int target_code_size = 0;
 	const uint32_t *target_code_src = NULL;
 
+	/* the work area holds at most chunk_size bytes of data */
+	while (nand->chunk_size && (unsigned)size > nand->chunk_size) {
+		retval = arm_nandwrite(nand, data, nand->chunk_size);
+		if (retval != ERROR_OK)
+			return retval;
+		data += nand->chunk_size;
+		size -= nand->chunk_size;
+	}
+
 	/* set up algorithm */
 	if (is_armv7m(target_to_armv7m(target))) {  /* armv7m target */
 		armv7m_algo.common_magic = ARMV7M_COMMON_MAGIC;
@@ -242,6 +251,15 @@ int arm_nandread(struct arm_nand_data *nand, uint8_t *data, uint32_t size)
 	int target_code_size = 0;
 	const uint32_t *target_code_src = NULL;
 
+	/* the work area holds at most chunk_size bytes of data */
+	while (nand->chunk_size && size > nand->chunk_size) {
+		retval = arm_nandread(nand, data, nand->chunk_size);
+		if (retval != ERROR_OK)
+			return retval;
+		data += nand->chunk_size;
+		size -= nand->chunk_size;
+	}
+
 	/* set up algorithm */
 	if (is_armv7m(target_to_armv7m(target))) {  /* armv7m target */
 		armv7m_algo.common_magic = ARMV7M_COMMON_MAGIC;
@@ -292,8 +310,9 @@ int arm_nandread(struct arm_nand_data *nand, uint8_t *data, uint32_t size)
 	destroy_reg_param(&reg_params[1]);
 	destroy_reg_param(&reg_params[2]);
 
-	/* read from work area to the host's memory */
-	retval = target_read_buffer(target, target_buf, size, data);
+	if (retval != ERROR_OK)
+		return retval;
 
-	return retval;
+	/* read from work area to the host's memory */
+	return target_read_buffer(target, target_buf, size, data);
 }
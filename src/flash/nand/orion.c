@@ -84,6 +84,18 @@ static int orion_nand_write(struct nand_device *nand, uint16_t data)
 	return ERROR_OK;
 }
 
+static int orion_nand_fast_block_read(struct nand_device *nand, uint8_t *data, int size)
+{
+	struct orion_nand_controller *hw = nand->controller_priv;
+	struct target *target = nand->target;
+
+	CHECK_HALTED;
+	hw->io.chunk_size = nand->page_size;
+
+	/* without a working area the core falls back to read_data() */
+	return arm_nandread(&hw->io, data, size);
+}
+
 static int orion_nand_slow_block_write(struct nand_device *nand, uint8_t *data, int size)
 {
 	while (size--)
@@ -154,6 +166,7 @@ struct nand_flash_controller orion_nand_controller = {
 	.address = orion_nand_address,
 	.read_data = orion_nand_read,
 	.write_data = orion_nand_write,
+	.read_block_data = orion_nand_fast_block_read,
 	.write_block_data = orion_nand_fast_block_write,
 	.reset = orion_nand_reset,
 	.nand_device_command = orion_nand_device_command,
@@ -32,6 +32,7 @@
 #include <target/armv7m.h>
 #include <target/mips32.h>
 #include <helper/binarybuffer.h>
+#include <helper/time_support.h>
 #include <target/algorithm.h>
 
 /* defines internal maximum size for code fragment in cfi_intel_write_block() */
@@ -178,6 +179,66 @@ int cfi_send_command(struct flash_bank *bank, uint8_t cmd, uint32_t address)
 	return cfi_target_write_memory(bank, address, 1, command);
 }
 
+/* Read the whole query table with a single memory access, so that the
+ * cfi_query_* helpers below don't need a round trip for every field.
+ * Must be called in query mode; the copy is dropped when leaving it. */
+static int cfi_query_table_load(struct flash_bank *bank)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	unsigned int words = CFI_QUERY_BUF_WORDS;
+	int retval;
+
+	cfi_info->query_buf_words = 0;
+
+	if (cfi_info->x16_as_x8) {
+		/* query words are spread over every other bus word */
+		uint8_t buf[2 * CFI_QUERY_BUF_WORDS * CFI_MAX_BUS_WIDTH];
+
+		retval = cfi_target_read_memory(bank, cfi_flash_address(bank, 0, 0),
+				2 * words, buf);
+		if (retval != ERROR_OK)
+			return retval;
+		for (unsigned int i = 0; i < words; i++)
+			memcpy(cfi_info->query_buf + i * bank->bus_width,
+					buf + 2 * i * bank->bus_width, bank->bus_width);
+	} else {
+		retval = cfi_target_read_memory(bank, cfi_flash_address(bank, 0, 0),
+				words, cfi_info->query_buf);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	cfi_info->query_buf_words = words;
+	return ERROR_OK;
+}
+
+/* read count consecutive query words, one per bus_width bytes of data */
+static int cfi_query_read(struct flash_bank *bank, int sector, uint32_t offset,
+		unsigned int count, uint8_t *data)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	int retval;
+
+	if (sector == 0 && offset + count <= cfi_info->query_buf_words) {
+		memcpy(data, cfi_info->query_buf + offset * bank->bus_width,
+				count * bank->bus_width);
+		return ERROR_OK;
+	}
+
+	if (cfi_info->x16_as_x8 && count > 1) {
+		for (unsigned int i = 0; i < count; i++) {
+			retval = cfi_target_read_memory(bank, cfi_flash_address(bank, sector, offset + i),
+							1, &data[i * bank->bus_width]);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		return ERROR_OK;
+	}
+
+	return cfi_target_read_memory(bank, cfi_flash_address(bank, sector, offset),
+			count, data);
+}
+
 /* read unsigned 8-bit value from the bank
  * flash banks are expected to be made of similar chips
  * the query result should be the same for all
@@ -188,8 +249,7 @@ static int cfi_query_u8(struct flash_bank *bank, int sector, uint32_t offset, ui
 	uint8_t data[CFI_MAX_BUS_WIDTH];
 
 	int retval;
-	retval = cfi_target_read_memory(bank, cfi_flash_address(bank, sector, offset),
-					1, data);
+	retval = cfi_query_read(bank, sector, offset, 1, data);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -237,19 +297,9 @@ static int cfi_query_u16(struct flash_bank *bank, int sector, uint32_t offset, u
 	uint8_t data[CFI_MAX_BUS_WIDTH * 2];
 	int retval;
 
-	if (cfi_info->x16_as_x8) {
-		for (uint8_t i = 0; i < 2; i++) {
-			retval = cfi_target_read_memory(bank, cfi_flash_address(bank, sector, offset + i),
-							1, &data[i * bank->bus_width]);
-			if (retval != ERROR_OK)
-				return retval;
-		}
-	} else {
-		retval = cfi_target_read_memory(bank, cfi_flash_address(bank, sector, offset),
-						2, data);
-		if (retval != ERROR_OK)
-			return retval;
-	}
+	retval = cfi_query_read(bank, sector, offset, 2, data);
+	if (retval != ERROR_OK)
+		return retval;
 
 	if (cfi_info->endianness == TARGET_LITTLE_ENDIAN)
 		*val = data[0] | data[bank->bus_width] << 8;
@@ -265,19 +315,9 @@ static int cfi_query_u32(struct flash_bank *bank, int sector, uint32_t offset, u
 	uint8_t data[CFI_MAX_BUS_WIDTH * 4];
 	int retval;
 
-	if (cfi_info->x16_as_x8) {
-		for (uint8_t i = 0; i < 4; i++) {
-			retval = cfi_target_read_memory(bank, cfi_flash_address(bank, sector, offset + i),
-							1, &data[i * bank->bus_width]);
-			if (retval != ERROR_OK)
-				return retval;
-		}
-	} else {
-		retval = cfi_target_read_memory(bank, cfi_flash_address(bank, sector, offset),
-						4, data);
-		if (retval != ERROR_OK)
-			return retval;
-	}
+	retval = cfi_query_read(bank, sector, offset, 4, data);
+	if (retval != ERROR_OK)
+		return retval;
 
 	if (cfi_info->endianness == TARGET_LITTLE_ENDIAN)
 		*val = data[0] | data[bank->bus_width] << 8 |
@@ -320,18 +360,31 @@ static void cfi_intel_clear_status_register(struct flash_bank *bank)
 	cfi_send_command(bank, 0x50, cfi_flash_address(bank, 0, 0x0));
 }
 
+/* Word programs usually complete before the status read reaches the
+ * chip, so poll back to back a few times before backing off to sleeps
+ * doubling up to 1 << CFI_POLL_MAX_DELAY_SHIFT ms. */
+#define CFI_POLL_FAST_COUNT		4
+#define CFI_POLL_MAX_DELAY_SHIFT	3
+
+static void cfi_poll_delay(unsigned int poll)
+{
+	if (poll < CFI_POLL_FAST_COUNT) {
+		keep_alive();
+		return;
+	}
+
+	poll -= CFI_POLL_FAST_COUNT;
+	alive_sleep(1 << MIN(poll, CFI_POLL_MAX_DELAY_SHIFT));
+}
+
 static int cfi_intel_wait_status_busy(struct flash_bank *bank, int timeout, uint8_t *val)
 {
 	uint8_t status;
+	int64_t then = timeval_ms() + timeout;
 
 	int retval = ERROR_OK;
 
-	for (;; ) {
-		if (timeout-- < 0) {
-			LOG_ERROR("timeout while waiting for WSM to become ready");
-			return ERROR_FAIL;
-		}
-
+	for (unsigned int poll = 0; ; poll++) {
 		retval = cfi_get_u8(bank, 0, 0x0, &status);
 		if (retval != ERROR_OK)
 			return retval;
@@ -339,7 +392,12 @@ static int cfi_intel_wait_status_busy(struct flash_bank *bank, int timeout, uint
 		if (status & 0x80)
 			break;
 
-		alive_sleep(1);
+		if (timeval_ms() > then) {
+			LOG_ERROR("timeout while waiting for WSM to become ready");
+			return ERROR_FAIL;
+		}
+
+		cfi_poll_delay(poll);
 	}
 
 	/* mask out bit 0 (reserved) */
@@ -375,6 +433,8 @@ int cfi_spansion_wait_status_busy(struct flash_bank *bank, int timeout)
 {
 	uint8_t status, oldstatus;
 	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	int64_t then = timeval_ms() + timeout;
+	unsigned int poll = 0;
 	int retval;
 
 	retval = cfi_get_u8(bank, 0, 0x0, &oldstatus);
@@ -409,8 +469,8 @@ int cfi_spansion_wait_status_busy(struct flash_bank *bank, int timeout)
 		}
 
 		oldstatus = status;
-		alive_sleep(1);
-	} while (timeout-- > 0);
+		cfi_poll_delay(poll++);
+	} while (timeval_ms() <= then);
 
 	LOG_ERROR("timeout, status: 0x%x", status);
 
@@ -2319,6 +2379,16 @@ static int cfi_read(struct flash_bank *bank, uint8_t *buffer, uint32_t offset, u
 	return ERROR_OK;
 }
 
+/* Programming can only clear bits, so words matching the erased value
+ * need no program cycle at all */
+static bool cfi_is_erased_data(struct flash_bank *bank, const uint8_t *data, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+		if (data[i] != bank->erased_value)
+			return false;
+	return true;
+}
+
 static int cfi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t offset, uint32_t count)
 {
 	struct cfi_flash_bank *cfi_info = bank->driver_priv;
@@ -2429,7 +2499,10 @@ static int cfi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t of
 				fallback = true;
 				if ((bufferwsize > 0) && (count >= buffersize) &&
 						!(write_p & buffermask)) {
-					retval = cfi_write_words(bank, buffer, bufferwsize, write_p);
+					if (cfi_is_erased_data(bank, buffer, buffersize))
+						retval = ERROR_OK;
+					else
+						retval = cfi_write_words(bank, buffer, bufferwsize, write_p);
 					if (retval == ERROR_OK) {
 						buffer += buffersize;
 						write_p += buffersize;
@@ -2443,9 +2516,11 @@ static int cfi_write(struct flash_bank *bank, const uint8_t *buffer, uint32_t of
 					for (int i = 0; i < bank->bus_width; i++)
 						current_word[i] = *buffer++;
 
-					retval = cfi_write_word(bank, current_word, write_p);
-					if (retval != ERROR_OK)
-						return retval;
+					if (!cfi_is_erased_data(bank, current_word, bank->bus_width)) {
+						retval = cfi_write_word(bank, current_word, write_p);
+						if (retval != ERROR_OK)
+							return retval;
+					}
 
 					write_p += bank->bus_width;
 					count -= bank->bus_width;
@@ -2548,6 +2623,10 @@ static int cfi_query_string(struct flash_bank *bank, int address)
 	if (retval != ERROR_OK)
 		return retval;
 
+	/* on failure the fields are simply read one by one */
+	if (cfi_query_table_load(bank) != ERROR_OK)
+		LOG_DEBUG("bulk read of CFI query table failed");
+
 	retval = cfi_query_u8(bank, 0, 0x10, &cfi_info->qry[0]);
 	if (retval != ERROR_OK)
 		return retval;
@@ -2562,6 +2641,7 @@ static int cfi_query_string(struct flash_bank *bank, int address)
 		cfi_info->qry[0], cfi_info->qry[1], cfi_info->qry[2]);
 
 	if ((cfi_info->qry[0] != 'Q') || (cfi_info->qry[1] != 'R') || (cfi_info->qry[2] != 'Y')) {
+		cfi_info->query_buf_words = 0;
 		retval = cfi_reset(bank);
 		if (retval != ERROR_OK)
 			return retval;
@@ -2572,6 +2652,251 @@ static int cfi_query_string(struct flash_bank *bank, int address)
 	return ERROR_OK;
 }
 
+/* Layout of a probe cache entry: the CFI query fields read by cfi_probe()
+ * followed by the primary extended query table as read (before fixups).
+ * Everything is stored field by field, multi-byte fields little endian. */
+#define CFI_PROBE_CACHE_VERSION		2
+#define CFI_PROBE_CACHE_HDR_SIZE	38
+#define CFI_PROBE_CACHE_INTEL_SIZE	19
+#define CFI_PROBE_CACHE_SPANSION_SIZE	28
+#define CFI_PROBE_CACHE_MAX_SIZE	1024
+
+static char *cfi_probe_cache_key(struct flash_bank *bank)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+
+	return alloc_printf("cfi%d:%04x:%04x:%d:%d:%d:%d", CFI_PROBE_CACHE_VERSION,
+			cfi_info->manufacturer, cfi_info->device_id,
+			bank->chip_width, bank->bus_width,
+			cfi_info->x16_as_x8, cfi_info->jedec_probe);
+}
+
+static size_t cfi_probe_cache_pri_ext_size(uint16_t pri_id)
+{
+	switch (pri_id) {
+		case 0x0001:
+		case 0x0003:
+			return CFI_PROBE_CACHE_INTEL_SIZE;
+		case 0x0002:
+			/* the Atmel table is converted to the Spansion layout */
+			return CFI_PROBE_CACHE_SPANSION_SIZE;
+		default:
+			return 0;
+	}
+}
+
+static void cfi_probe_cache_put_pri_ext(struct cfi_flash_bank *cfi_info, uint8_t *buf)
+{
+	if (cfi_info->pri_id == 0x0002) {
+		struct cfi_spansion_pri_ext *pri_ext = cfi_info->pri_ext;
+
+		memcpy(buf, pri_ext->pri, 3);
+		buf[3] = pri_ext->major_version;
+		buf[4] = pri_ext->minor_version;
+		buf[5] = pri_ext->SiliconRevision;
+		buf[6] = pri_ext->EraseSuspend;
+		buf[7] = pri_ext->BlkProt;
+		buf[8] = pri_ext->TmpBlkUnprotect;
+		buf[9] = pri_ext->BlkProtUnprot;
+		buf[10] = pri_ext->SimultaneousOps;
+		buf[11] = pri_ext->BurstMode;
+		buf[12] = pri_ext->PageMode;
+		buf[13] = pri_ext->VppMin;
+		buf[14] = pri_ext->VppMax;
+		buf[15] = pri_ext->TopBottom;
+		h_u32_to_le(buf + 16, pri_ext->_reversed_geometry);
+		h_u32_to_le(buf + 20, pri_ext->_unlock1);
+		h_u32_to_le(buf + 24, pri_ext->_unlock2);
+	} else {
+		struct cfi_intel_pri_ext *pri_ext = cfi_info->pri_ext;
+
+		memcpy(buf, pri_ext->pri, 3);
+		buf[3] = pri_ext->major_version;
+		buf[4] = pri_ext->minor_version;
+		h_u32_to_le(buf + 5, pri_ext->feature_support);
+		buf[9] = pri_ext->suspend_cmd_support;
+		h_u16_to_le(buf + 10, pri_ext->blk_status_reg_mask);
+		buf[12] = pri_ext->vcc_optimal;
+		buf[13] = pri_ext->vpp_optimal;
+		buf[14] = pri_ext->num_protection_fields;
+		h_u16_to_le(buf + 15, pri_ext->prot_reg_addr);
+		buf[17] = pri_ext->fact_prot_reg_size;
+		buf[18] = pri_ext->user_prot_reg_size;
+	}
+}
+
+static void *cfi_probe_cache_get_pri_ext(uint16_t pri_id, const uint8_t *buf)
+{
+	if (pri_id == 0x0002) {
+		struct cfi_spansion_pri_ext *pri_ext = malloc(sizeof(*pri_ext));
+		if (!pri_ext)
+			return NULL;
+
+		memcpy(pri_ext->pri, buf, 3);
+		pri_ext->major_version = buf[3];
+		pri_ext->minor_version = buf[4];
+		pri_ext->SiliconRevision = buf[5];
+		pri_ext->EraseSuspend = buf[6];
+		pri_ext->BlkProt = buf[7];
+		pri_ext->TmpBlkUnprotect = buf[8];
+		pri_ext->BlkProtUnprot = buf[9];
+		pri_ext->SimultaneousOps = buf[10];
+		pri_ext->BurstMode = buf[11];
+		pri_ext->PageMode = buf[12];
+		pri_ext->VppMin = buf[13];
+		pri_ext->VppMax = buf[14];
+		pri_ext->TopBottom = buf[15];
+		pri_ext->_reversed_geometry = le_to_h_u32(buf + 16);
+		pri_ext->_unlock1 = le_to_h_u32(buf + 20);
+		pri_ext->_unlock2 = le_to_h_u32(buf + 24);
+		return pri_ext;
+	}
+
+	struct cfi_intel_pri_ext *pri_ext = malloc(sizeof(*pri_ext));
+	if (!pri_ext)
+		return NULL;
+
+	memcpy(pri_ext->pri, buf, 3);
+	pri_ext->major_version = buf[3];
+	pri_ext->minor_version = buf[4];
+	pri_ext->feature_support = le_to_h_u32(buf + 5);
+	pri_ext->suspend_cmd_support = buf[9];
+	pri_ext->blk_status_reg_mask = le_to_h_u16(buf + 10);
+	pri_ext->vcc_optimal = buf[12];
+	pri_ext->vpp_optimal = buf[13];
+	pri_ext->num_protection_fields = buf[14];
+	pri_ext->prot_reg_addr = le_to_h_u16(buf + 15);
+	pri_ext->fact_prot_reg_size = buf[17];
+	pri_ext->user_prot_reg_size = buf[18];
+	return pri_ext;
+}
+
+static void cfi_probe_cache_save(struct flash_bank *bank)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	size_t pri_ext_size = cfi_info->pri_ext ?
+		cfi_probe_cache_pri_ext_size(cfi_info->pri_id) : 0;
+	size_t size = CFI_PROBE_CACHE_HDR_SIZE + 4 * cfi_info->num_erase_regions
+		+ pri_ext_size;
+
+	if (size > CFI_PROBE_CACHE_MAX_SIZE)
+		return;
+
+	uint8_t *buf = malloc(size);
+	char *key = cfi_probe_cache_key(bank);
+	if (!buf || !key)
+		goto done;
+
+	memcpy(buf, cfi_info->qry, 3);
+	h_u16_to_le(buf + 3, cfi_info->pri_id);
+	h_u16_to_le(buf + 5, cfi_info->pri_addr);
+	h_u16_to_le(buf + 7, cfi_info->alt_id);
+	h_u16_to_le(buf + 9, cfi_info->alt_addr);
+	buf[11] = cfi_info->vcc_min;
+	buf[12] = cfi_info->vcc_max;
+	buf[13] = cfi_info->vpp_min;
+	buf[14] = cfi_info->vpp_max;
+	buf[15] = cfi_info->word_write_timeout_typ;
+	buf[16] = cfi_info->buf_write_timeout_typ;
+	buf[17] = cfi_info->block_erase_timeout_typ;
+	buf[18] = cfi_info->chip_erase_timeout_typ;
+	buf[19] = cfi_info->word_write_timeout_max;
+	buf[20] = cfi_info->buf_write_timeout_max;
+	buf[21] = cfi_info->block_erase_timeout_max;
+	buf[22] = cfi_info->chip_erase_timeout_max;
+	h_u32_to_le(buf + 23, cfi_info->dev_size);
+	h_u16_to_le(buf + 27, cfi_info->interface_desc);
+	h_u16_to_le(buf + 29, cfi_info->max_buf_write_size);
+	buf[31] = cfi_info->num_erase_regions;
+	h_u32_to_le(buf + 32, pri_ext_size);
+	buf[36] = cfi_info->status_poll_mask;
+	buf[37] = 0;
+
+	uint8_t *p = buf + CFI_PROBE_CACHE_HDR_SIZE;
+	for (unsigned int i = 0; i < cfi_info->num_erase_regions; i++, p += 4)
+		h_u32_to_le(p, cfi_info->erase_region_info[i]);
+	if (pri_ext_size)
+		cfi_probe_cache_put_pri_ext(cfi_info, p);
+
+	flash_probe_cache_store(bank, key, buf, size);
+
+done:
+	free(key);
+	free(buf);
+}
+
+/* Restore what cfi_probe() would read from the query table, based on the
+ * manufacturer and device IDs already read from the chip. */
+static int cfi_probe_cache_restore(struct flash_bank *bank)
+{
+	struct cfi_flash_bank *cfi_info = bank->driver_priv;
+	uint8_t buf[CFI_PROBE_CACHE_MAX_SIZE];
+	size_t size = sizeof(buf);
+
+	char *key = cfi_probe_cache_key(bank);
+	if (!key)
+		return ERROR_FAIL;
+	int retval = flash_probe_cache_load(bank, key, buf, &size);
+	free(key);
+	if (retval != ERROR_OK || size < CFI_PROBE_CACHE_HDR_SIZE)
+		return ERROR_FAIL;
+
+	unsigned int num_erase_regions = buf[31];
+	size_t pri_ext_size = le_to_h_u32(buf + 32);
+	if (size != CFI_PROBE_CACHE_HDR_SIZE + 4 * num_erase_regions + pri_ext_size)
+		return ERROR_FAIL;
+
+	/* pri_id decides how pri_ext is interpreted, so the sizes must agree */
+	uint16_t pri_id = le_to_h_u16(buf + 3);
+	if (pri_ext_size && cfi_probe_cache_pri_ext_size(pri_id) != pri_ext_size)
+		return ERROR_FAIL;
+
+	memcpy(cfi_info->qry, buf, 3);
+	cfi_info->pri_id = pri_id;
+	cfi_info->pri_addr = le_to_h_u16(buf + 5);
+	cfi_info->alt_id = le_to_h_u16(buf + 7);
+	cfi_info->alt_addr = le_to_h_u16(buf + 9);
+
+	free(cfi_info->pri_ext);
+	cfi_info->pri_ext = NULL;
+	if (pri_ext_size) {
+		cfi_info->pri_ext = cfi_probe_cache_get_pri_ext(pri_id,
+				buf + CFI_PROBE_CACHE_HDR_SIZE + 4 * num_erase_regions);
+		if (!cfi_info->pri_ext)
+			return ERROR_FAIL;
+	}
+
+	if (num_erase_regions) {
+		cfi_info->erase_region_info = malloc(4 * num_erase_regions);
+		if (!cfi_info->erase_region_info)
+			return ERROR_FAIL;
+		for (unsigned int i = 0; i < num_erase_regions; i++)
+			cfi_info->erase_region_info[i] =
+				le_to_h_u32(buf + CFI_PROBE_CACHE_HDR_SIZE + 4 * i);
+	}
+
+	cfi_info->vcc_min = buf[11];
+	cfi_info->vcc_max = buf[12];
+	cfi_info->vpp_min = buf[13];
+	cfi_info->vpp_max = buf[14];
+	cfi_info->word_write_timeout_typ = buf[15];
+	cfi_info->buf_write_timeout_typ = buf[16];
+	cfi_info->block_erase_timeout_typ = buf[17];
+	cfi_info->chip_erase_timeout_typ = buf[18];
+	cfi_info->word_write_timeout_max = buf[19];
+	cfi_info->buf_write_timeout_max = buf[20];
+	cfi_info->block_erase_timeout_max = buf[21];
+	cfi_info->chip_erase_timeout_max = buf[22];
+	cfi_info->dev_size = le_to_h_u32(buf + 23);
+	cfi_info->interface_desc = le_to_h_u16(buf + 27);
+	cfi_info->max_buf_write_size = le_to_h_u16(buf + 29);
+	cfi_info->num_erase_regions = num_erase_regions;
+	cfi_info->status_poll_mask = buf[36];
+
+	LOG_INFO("Flash bank %s: CFI query data restored from probe cache", bank->name);
+	return ERROR_OK;
+}
+
 int cfi_probe(struct flash_bank *bank)
 {
 	struct cfi_flash_bank *cfi_info = bank->driver_priv;
@@ -2590,6 +2915,7 @@ int cfi_probe(struct flash_bank *bank)
 
 	cfi_info->probed = false;
 	cfi_info->num_erase_regions = 0;
+	cfi_info->query_buf_words = 0;
 	if (bank->sectors) {
 		free(bank->sectors);
 		bank->sectors = NULL;
@@ -2655,10 +2981,10 @@ int cfi_probe(struct flash_bank *bank)
 	/* check device/manufacturer ID for known non-CFI flashes. */
 	cfi_fixup_non_cfi(bank);
 
-	/* query only if this is a CFI compatible flash,
-	 * otherwise the relevant info has already been filled in
+	/* query only if this is a CFI compatible flash and the query data
+	 * is not cached, otherwise the relevant info has already been filled in
 	 */
-	if (cfi_info->not_cfi == 0) {
+	if (cfi_info->not_cfi == 0 && cfi_probe_cache_restore(bank) != ERROR_OK) {
 		/* enter CFI query mode
 		 * according to JEDEC Standard No. 68.01,
 		 * a single bus sequence with address = 0x55, data = 0x98 should put
@@ -2804,9 +3130,12 @@ int cfi_probe(struct flash_bank *bank)
 		/* return to read array mode
 		 * we use both reset commands, as some Intel flashes fail to recognize the 0xF0 command
 		 */
+		cfi_info->query_buf_words = 0;
 		retval = cfi_reset(bank);
 		if (retval != ERROR_OK)
 			return retval;
+
+		cfi_probe_cache_save(bank);
 	}	/* end CFI case */
 
 	LOG_DEBUG("Vcc min: %x.%x, Vcc max: %x.%x, Vpp min: %u.%x, Vpp max: %u.%x",
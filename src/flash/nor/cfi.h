@@ -22,6 +22,13 @@
 #define CFI_STATUS_POLL_MASK_DQ5_DQ6_DQ7 0xE0 /* DQ5..DQ7 */
 #define CFI_STATUS_POLL_MASK_DQ6_DQ7     0xC0 /* DQ6..DQ7 */
 
+#define CFI_MAX_BUS_WIDTH       4
+#define CFI_MAX_CHIP_WIDTH      4
+
+/* Number of query words read in one go while probing; covers the basic
+ * query table and the usual location of the extended tables */
+#define CFI_QUERY_BUF_WORDS		0x80
+
 struct cfi_flash_bank {
 	int x16_as_x8;
 	int jedec_probe;
@@ -58,6 +65,10 @@ struct cfi_flash_bank {
 
 	uint8_t status_poll_mask;
 
+	/* copy of the query table, valid while probing only */
+	unsigned int query_buf_words;
+	uint8_t query_buf[CFI_QUERY_BUF_WORDS * CFI_MAX_BUS_WIDTH];
+
 	/* flash geometry */
 	uint32_t dev_size;
 	uint16_t interface_desc;
@@ -184,7 +195,4 @@ int cfi_target_read_memory(struct flash_bank *bank, target_addr_t addr,
 #define CFI_MFR_ANY		0xffff
 #define CFI_ID_ANY		0xffff
 
-#define CFI_MAX_BUS_WIDTH       4
-#define CFI_MAX_CHIP_WIDTH      4
-
 #endif /* OPENOCD_FLASH_NOR_CFI_H */
@@ -27,6 +27,9 @@
 #include <flash/nor/core.h>
 #include <flash/nor/imp.h>
 #include <target/image.h>
+#include <helper/time_support.h>
+#include <helper/binarybuffer.h>
+#include <jtag/jtag.h>
 
 /**
  * @file
@@ -585,6 +588,76 @@ int flash_erase_address_range(struct target *target,
 		addr, length, false, &flash_driver_erase);
 }
 
+/* Blank check sectors first..last with the on-target algorithm and set
+ * blank[i] for each sector first + i proven to be blank. */
+static void flash_blank_check_sectors(struct flash_bank *bank, int first, int last,
+		uint8_t *blank)
+{
+	int num = last - first + 1;
+	struct target_memory_check_block *blocks = malloc(num * sizeof(*blocks));
+	if (blocks == NULL)
+		return;
+
+	for (int i = 0; i < num; i++) {
+		blocks[i].address = bank->base + bank->sectors[first + i].offset;
+		blocks[i].size = bank->sectors[first + i].size;
+		blocks[i].result = 0; /* erase it unless proven blank */
+	}
+
+	for (int i = 0; i < num; ) {
+		int retval = target_blank_check_memory(bank->target,
+				blocks + i, num - i, bank->erased_value);
+		if (retval < 1)
+			break;
+		i += retval;
+	}
+
+	for (int i = 0; i < num; i++)
+		blank[i] = blocks[i].result == 1;
+	free(blocks);
+}
+
+/* Erase callback used while writing an image: blank check the sectors
+ * with the on-target algorithm and erase only runs of non-blank ones.
+ * Without a blank check algorithm (no working area) all are erased. */
+static int flash_driver_erase_dirty(struct flash_bank *bank, int first, int last)
+{
+	if (!bank->erase_skip_blank || bank->target->state != TARGET_HALTED)
+		return flash_driver_erase(bank, first, last);
+
+	int num = last - first + 1;
+	uint8_t *blank = calloc(num, sizeof(*blank));
+	if (blank == NULL)
+		return flash_driver_erase(bank, first, last);
+
+	flash_blank_check_sectors(bank, first, last, blank);
+
+	int retval = ERROR_OK;
+	int skipped = 0;
+	for (int i = 0; i < num && retval == ERROR_OK; ) {
+		if (blank[i]) {
+			bank->sectors[first + i].is_erased = 1;
+			skipped++;
+			i++;
+			continue;
+		}
+
+		int run_end = i;
+		while (run_end + 1 < num && !blank[run_end + 1])
+			run_end++;
+
+		retval = flash_driver_erase(bank, first + i, first + run_end);
+		i = run_end + 1;
+	}
+	free(blank);
+
+	if (skipped)
+		LOG_INFO("flash bank %s: %d of %d sectors already blank, not erased",
+				bank->name, skipped, num);
+
+	return retval;
+}
+
 static int flash_driver_unprotect(struct flash_bank *bank, int first, int last)
 {
 	return flash_driver_protect(bank, 0, first, last);
@@ -696,258 +769,561 @@ static bool flash_write_check_gap(struct flash_bank *bank,
 }
 
 
-int flash_write_unlock(struct target *target, struct image *image,
-	uint32_t *written, int erase, bool unlock)
-{
-	int retval = ERROR_OK;
-
-	int section;
-	uint32_t section_offset;
-	struct flash_bank *c;
-	int *padding;
-
-	section = 0;
-	section_offset = 0;
+/* Per bank statistics of the last flash_write_unlock() call */
+static struct flash_write_bank_stats *flash_write_stats;
+static int flash_write_num_stats;
 
-	if (written)
-		*written = 0;
-
-	if (erase) {
-		/* assume all sectors need erasing - stops any problems
-		 * when flash_write is called multiple times */
+int flash_write_get_stats(const struct flash_write_bank_stats **stats)
+{
+	*stats = flash_write_stats;
+	return flash_write_num_stats;
+}
 
-		flash_set_dirty();
-	}
+static struct flash_write_bank_stats *flash_write_stats_get(struct flash_bank *bank)
+{
+	for (int i = 0; i < flash_write_num_stats; i++)
+		if (flash_write_stats[i].bank == bank)
+			return &flash_write_stats[i];
 
-	/* allocate padding array */
-	padding = calloc(image->num_sections, sizeof(*padding));
+	struct flash_write_bank_stats *n = realloc(flash_write_stats,
+			(flash_write_num_stats + 1) * sizeof(*n));
+	if (n == NULL)
+		return NULL;
+	flash_write_stats = n;
+	n = &n[flash_write_num_stats++];
+	memset(n, 0, sizeof(*n));
+	n->bank = bank;
+	return n;
+}
 
-	/* This fn requires all sections to be in ascending order of addresses,
-	 * whereas an image can have sections out of order. */
-	struct imagesection **sections = malloc(sizeof(struct imagesection *) *
-			image->num_sections);
-	int i;
-	for (i = 0; i < image->num_sections; i++)
-		sections[i] = &image->sections[i];
+/* One write to a single bank, built from consecutive image sections */
+struct flash_write_run {
+	struct flash_bank *bank;
+	target_addr_t address;
+	uint32_t size;
+	uint8_t *buffer;
+};
+
+/* Collect the next image sections that go to one bank and read them, padded
+ * as the bank requires, into a new run->buffer.  run->bank is left NULL
+ * once the end of the image is reached. */
+static int flash_write_next_run(struct target *target, struct image *image,
+		struct imagesection **sections, int *padding, int *p_section,
+		uint32_t *p_section_offset, int erase, bool unlock,
+		struct flash_write_run *run)
+{
+	int section = *p_section;
+	uint32_t section_offset = *p_section_offset;
+	uint32_t buffer_idx;
+	uint8_t *buffer;
+	int section_last;
+	target_addr_t run_address = 0;
+	uint32_t run_size = 0;
+	int pad_bytes = 0;
+	struct flash_bank *c = NULL;
+	int retval;
 
-	qsort(sections, image->num_sections, sizeof(struct imagesection *),
-		compare_section);
+	memset(run, 0, sizeof(*run));
 
-	/* loop until we reach end of the image */
 	while (section < image->num_sections) {
-		uint32_t buffer_idx;
-		uint8_t *buffer;
-		int section_last;
-		target_addr_t run_address = sections[section]->base_address + section_offset;
-		uint32_t run_size = sections[section]->size - section_offset;
-		int pad_bytes = 0;
+		run_address = sections[section]->base_address + section_offset;
+		run_size = sections[section]->size - section_offset;
 
 		if (sections[section]->size ==  0) {
 			LOG_WARNING("empty section %d", section);
-			section++;
-			section_offset = 0;
-			continue;
+		} else {
+			/* find the corresponding flash bank */
+			retval = get_flash_bank_by_addr(target, run_address, false, &c);
+			if (retval != ERROR_OK)
+				return retval;
+			if (c != NULL)
+				break;
+			LOG_WARNING("no flash bank found for address " TARGET_ADDR_FMT, run_address);
 		}
+		section++;	/* and skip it */
+		section_offset = 0;
+	}
 
-		/* find the corresponding flash bank */
-		retval = get_flash_bank_by_addr(target, run_address, false, &c);
-		if (retval != ERROR_OK)
-			goto done;
-		if (c == NULL) {
-			LOG_WARNING("no flash bank found for address " TARGET_ADDR_FMT, run_address);
-			section++;	/* and skip it */
-			section_offset = 0;
-			continue;
+	if (section >= image->num_sections) {
+		*p_section = section;
+		*p_section_offset = 0;
+		return ERROR_OK;
+	}
+
+	/* collect consecutive sections which fall into the same bank */
+	section_last = section;
+	padding[section] = 0;
+	while ((run_address + run_size - 1 < c->base + c->size - 1) &&
+			(section_last + 1 < image->num_sections)) {
+		/* sections are sorted */
+		assert(sections[section_last + 1]->base_address >= c->base);
+		if (sections[section_last + 1]->base_address >= (c->base + c->size)) {
+			/* Done with this bank */
+			break;
 		}
 
-		/* collect consecutive sections which fall into the same bank */
-		section_last = section;
-		padding[section] = 0;
-		while ((run_address + run_size - 1 < c->base + c->size - 1) &&
-				(section_last + 1 < image->num_sections)) {
-			/* sections are sorted */
-			assert(sections[section_last + 1]->base_address >= c->base);
-			if (sections[section_last + 1]->base_address >= (c->base + c->size)) {
-				/* Done with this bank */
+		/* if we have multiple sections within our image,
+		 * flash programming could fail due to alignment issues
+		 * attempt to rebuild a consecutive buffer for the flash loader */
+		target_addr_t run_next_addr = run_address + run_size;
+		target_addr_t next_section_base = sections[section_last + 1]->base_address;
+		if (next_section_base < run_next_addr) {
+			LOG_ERROR("Section at " TARGET_ADDR_FMT
+				" overlaps section ending at " TARGET_ADDR_FMT,
+				next_section_base, run_next_addr);
+			LOG_ERROR("Flash write aborted.");
+			return ERROR_FAIL;
+		}
+
+		pad_bytes = next_section_base - run_next_addr;
+		if (pad_bytes) {
+			if (flash_write_check_gap(c, run_next_addr - 1, next_section_base)) {
+				LOG_INFO("Flash write discontinued at " TARGET_ADDR_FMT
+					", next section at " TARGET_ADDR_FMT,
+					run_next_addr, next_section_base);
 				break;
 			}
+		}
+		if (pad_bytes > 0)
+			LOG_INFO("Padding image section %d at " TARGET_ADDR_FMT
+				" with %d bytes",
+				section_last, run_next_addr, pad_bytes);
+
+		padding[section_last] = pad_bytes;
+		run_size += pad_bytes;
+		run_size += sections[++section_last]->size;
+	}
 
-			/* if we have multiple sections within our image,
-			 * flash programming could fail due to alignment issues
-			 * attempt to rebuild a consecutive buffer for the flash loader */
-			target_addr_t run_next_addr = run_address + run_size;
-			target_addr_t next_section_base = sections[section_last + 1]->base_address;
-			if (next_section_base < run_next_addr) {
-				LOG_ERROR("Section at " TARGET_ADDR_FMT
-					" overlaps section ending at " TARGET_ADDR_FMT,
-					next_section_base, run_next_addr);
-				LOG_ERROR("Flash write aborted.");
-				retval = ERROR_FAIL;
-				goto done;
-			}
+	if (run_address + run_size - 1 > c->base + c->size - 1) {
+		/* If we have more than one flash chip back to back, then we limit
+		 * the current write operation to the current chip.
+		 */
+		LOG_DEBUG("Truncate flash run size to the current flash chip.");
 
-			pad_bytes = next_section_base - run_next_addr;
-			if (pad_bytes) {
-				if (flash_write_check_gap(c, run_next_addr - 1, next_section_base)) {
-					LOG_INFO("Flash write discontinued at " TARGET_ADDR_FMT
-						", next section at " TARGET_ADDR_FMT,
-						run_next_addr, next_section_base);
-					break;
-				}
-			}
-			if (pad_bytes > 0)
-				LOG_INFO("Padding image section %d at " TARGET_ADDR_FMT
-					" with %d bytes",
-					section_last, run_next_addr, pad_bytes);
+		run_size = c->base + c->size - run_address;
+		assert(run_size > 0);
+	}
+
+	uint32_t padding_at_start = 0;
+	if (c->write_start_alignment || c->write_end_alignment) {
+		/* align write region according to bank requirements */
+		target_addr_t aligned_start = flash_write_align_start(c, run_address);
+		padding_at_start = run_address - aligned_start;
+		if (padding_at_start > 0) {
+			LOG_WARNING("Section start address " TARGET_ADDR_FMT
+				" breaks the required alignment of flash bank %s",
+				run_address, c->name);
+			LOG_WARNING("Padding %d bytes from " TARGET_ADDR_FMT,
+				padding_at_start, aligned_start);
+
+			run_address -= padding_at_start;
+			run_size += padding_at_start;
+		}
 
-			padding[section_last] = pad_bytes;
+		target_addr_t run_end = run_address + run_size - 1;
+		target_addr_t aligned_end = flash_write_align_end(c, run_end);
+		pad_bytes = aligned_end - run_end;
+		if (pad_bytes > 0) {
+			LOG_INFO("Padding image section %d at " TARGET_ADDR_FMT
+				" with %d bytes (bank write end alignment)",
+				section_last, run_end + 1, pad_bytes);
+
+			padding[section_last] += pad_bytes;
 			run_size += pad_bytes;
-			run_size += sections[++section_last]->size;
 		}
 
-		if (run_address + run_size - 1 > c->base + c->size - 1) {
-			/* If we have more than one flash chip back to back, then we limit
-			 * the current write operation to the current chip.
-			 */
-			LOG_DEBUG("Truncate flash run size to the current flash chip.");
-
-			run_size = c->base + c->size - run_address;
-			assert(run_size > 0);
-		}
-
-		uint32_t padding_at_start = 0;
-		if (c->write_start_alignment || c->write_end_alignment) {
-			/* align write region according to bank requirements */
-			target_addr_t aligned_start = flash_write_align_start(c, run_address);
-			padding_at_start = run_address - aligned_start;
-			if (padding_at_start > 0) {
-				LOG_WARNING("Section start address " TARGET_ADDR_FMT
-					" breaks the required alignment of flash bank %s",
-					run_address, c->name);
-				LOG_WARNING("Padding %d bytes from " TARGET_ADDR_FMT,
-					padding_at_start, aligned_start);
-
-				run_address -= padding_at_start;
-				run_size += padding_at_start;
-			}
+	} else if (unlock || erase) {
+		/* If we're applying any sector automagic, then pad this
+		 * (maybe-combined) segment to the end of its last sector.
+		 */
+		int sector;
+		uint32_t offset_start = run_address - c->base;
+		uint32_t offset_end = offset_start + run_size;
+		uint32_t end = offset_end, delta;
+
+		for (sector = 0; sector < c->num_sectors; sector++) {
+			end = c->sectors[sector].offset
+				+ c->sectors[sector].size;
+			if (offset_end <= end)
+				break;
+		}
 
-			target_addr_t run_end = run_address + run_size - 1;
-			target_addr_t aligned_end = flash_write_align_end(c, run_end);
-			pad_bytes = aligned_end - run_end;
-			if (pad_bytes > 0) {
-				LOG_INFO("Padding image section %d at " TARGET_ADDR_FMT
-					" with %d bytes (bank write end alignment)",
-					section_last, run_end + 1, pad_bytes);
+		delta = end - offset_end;
+		padding[section_last] += delta;
+		run_size += delta;
+	}
 
-				padding[section_last] += pad_bytes;
-				run_size += pad_bytes;
-			}
+	/* allocate buffer */
+	buffer = malloc(run_size);
+	if (buffer == NULL) {
+		LOG_ERROR("Out of memory for flash bank buffer");
+		return ERROR_FAIL;
+	}
 
-		} else if (unlock || erase) {
-			/* If we're applying any sector automagic, then pad this
-			 * (maybe-combined) segment to the end of its last sector.
-			 */
-			int sector;
-			uint32_t offset_start = run_address - c->base;
-			uint32_t offset_end = offset_start + run_size;
-			uint32_t end = offset_end, delta;
-
-			for (sector = 0; sector < c->num_sectors; sector++) {
-				end = c->sectors[sector].offset
-					+ c->sectors[sector].size;
-				if (offset_end <= end)
-					break;
-			}
+	if (padding_at_start)
+		memset(buffer, c->default_padded_value, padding_at_start);
+
+	buffer_idx = padding_at_start;
+
+	/* read sections to the buffer */
+	while (buffer_idx < run_size) {
+		size_t size_read;
+
+		size_read = run_size - buffer_idx;
+		if (size_read > sections[section]->size - section_offset)
+			size_read = sections[section]->size - section_offset;
+
+		/* KLUDGE!
+		 *
+		 * #¤%#"%¤% we have to figure out the section # from the sorted
+		 * list of pointers to sections to invoke image_read_section()...
+		 */
+		intptr_t diff = (intptr_t)sections[section] - (intptr_t)image->sections;
+		int t_section_num = diff / sizeof(struct imagesection);
+
+		LOG_DEBUG("image_read_section: section = %d, t_section_num = %d, "
+				"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
+			section, t_section_num, section_offset,
+			buffer_idx, size_read);
+		retval = image_read_section(image, t_section_num, section_offset,
+				size_read, buffer + buffer_idx, &size_read);
+		if (retval != ERROR_OK || size_read == 0) {
+			free(buffer);
+			return retval;
+		}
+
+		buffer_idx += size_read;
+		section_offset += size_read;
 
-			delta = end - offset_end;
-			padding[section_last] += delta;
-			run_size += delta;
+		/* see if we need to pad the section */
+		if (padding[section]) {
+			memset(buffer + buffer_idx, c->default_padded_value, padding[section]);
+			buffer_idx += padding[section];
 		}
 
-		/* allocate buffer */
-		buffer = malloc(run_size);
-		if (buffer == NULL) {
-			LOG_ERROR("Out of memory for flash bank buffer");
-			retval = ERROR_FAIL;
-			goto done;
+		if (section_offset >= sections[section]->size) {
+			section++;
+			section_offset = 0;
 		}
+	}
 
-		if (padding_at_start)
-			memset(buffer, c->default_padded_value, padding_at_start);
+	run->bank = c;
+	run->address = run_address;
+	run->size = run_size;
+	run->buffer = buffer;
+	*p_section = section;
+	*p_section_offset = section_offset;
+
+	return ERROR_OK;
+}
 
-		buffer_idx = padding_at_start;
+/* Time allowed for the erase of one sector started in the background */
+#define FLASH_ERASE_AHEAD_TIMEOUT	10000
 
-		/* read sections to the buffer */
-		while (buffer_idx < run_size) {
-			size_t size_read;
+/* Erase of the sectors of the next run, one sector at a time through the
+ * driver's erase_start()/erase_poll(), while the current run is written. */
+struct flash_erase_ahead {
+	struct flash_bank *bank;
+	int first, last;
+	int sector;		/* sector being erased, or the next one to start */
+	bool busy;		/* the erase of 'sector' has been started */
+	uint8_t *blank;		/* sectors first..last found blank, not erased */
+	int num_sectors;
+	int skipped;
+	int64_t start_ms;	/* when the erase-ahead started */
+	int64_t sector_ms;	/* when the erase of 'sector' started */
+};
+
+static int flash_erase_ahead_poll(struct flash_erase_ahead *ahead)
+{
+	struct flash_bank *bank = ahead->bank;
+	int retval;
 
-			size_read = run_size - buffer_idx;
-			if (size_read > sections[section]->size - section_offset)
-				size_read = sections[section]->size - section_offset;
+	if (ahead->busy) {
+		bool done = false;
 
-			/* KLUDGE!
-			 *
-			 * #¤%#"%¤% we have to figure out the section # from the sorted
-			 * list of pointers to sections to invoke image_read_section()...
-			 */
-			intptr_t diff = (intptr_t)sections[section] - (intptr_t)image->sections;
-			int t_section_num = diff / sizeof(struct imagesection);
-
-			LOG_DEBUG("image_read_section: section = %d, t_section_num = %d, "
-					"section_offset = %"PRIu32", buffer_idx = %"PRIu32", size_read = %zu",
-				section, t_section_num, section_offset,
-				buffer_idx, size_read);
-			retval = image_read_section(image, t_section_num, section_offset,
-					size_read, buffer + buffer_idx, &size_read);
-			if (retval != ERROR_OK || size_read == 0) {
-				free(buffer);
-				goto done;
-			}
+		retval = bank->driver->erase_poll(bank, ahead->sector, &done);
+		if (retval == ERROR_OK && !done &&
+				timeval_ms() - ahead->sector_ms > FLASH_ERASE_AHEAD_TIMEOUT) {
+			LOG_ERROR("flash bank %s: timeout erasing sector %d",
+					bank->name, ahead->sector);
+			retval = ERROR_FLASH_OPERATION_FAILED;
+		}
+		if (retval != ERROR_OK) {
+			ahead->busy = false;
+			ahead->last = ahead->sector - 1;
+			return retval;
+		}
+		if (!done)
+			return ERROR_OK;
 
-			buffer_idx += size_read;
-			section_offset += size_read;
+		bank->sectors[ahead->sector++].is_erased = 1;
+		ahead->busy = false;
+	}
 
-			/* see if we need to pad the section */
-			if (padding[section]) {
-				memset(buffer + buffer_idx, c->default_padded_value, padding[section]);
-				buffer_idx += padding[section];
-			}
+	while (ahead->sector <= ahead->last && ahead->blank[ahead->sector - ahead->first]) {
+		bank->sectors[ahead->sector++].is_erased = 1;
+		ahead->skipped++;
+	}
+
+	if (ahead->sector > ahead->last)
+		return ERROR_OK;
+
+	LOG_DEBUG("flash bank %s: erasing sector %d in the background",
+			bank->name, ahead->sector);
+	retval = bank->driver->erase_start(bank, ahead->sector);
+	if (retval != ERROR_OK) {
+		ahead->last = ahead->sector - 1;
+		return retval;
+	}
+	ahead->busy = true;
+	ahead->sector_ms = timeval_ms();
+
+	return ERROR_OK;
+}
+
+/* Start erasing the sectors covering address..address + size - 1 of 'bank'
+ * in the background.  Leaves ahead->bank NULL, and the caller to erase the
+ * usual way, if the driver can't. */
+static int flash_erase_ahead_begin(struct flash_erase_ahead *ahead,
+		struct target *target, target_addr_t address, uint32_t size)
+{
+	struct flash_bank *bank;
 
-			if (section_offset >= sections[section]->size) {
-				section++;
-				section_offset = 0;
+	memset(ahead, 0, sizeof(*ahead));
+
+	/* probes the bank */
+	int retval = get_flash_bank_by_addr(target, address, true, &bank);
+	if (retval != ERROR_OK)
+		return retval;
+	if (!bank->driver->erase_start || !bank->driver->erase_poll)
+		return ERROR_OK;
+
+	uint32_t offset = address - bank->base;
+	int first = -1, last = -1;
+	for (int i = 0; i < bank->num_sectors; i++) {
+		uint32_t sector_start = bank->sectors[i].offset;
+		uint32_t sector_end = sector_start + bank->sectors[i].size;
+		if (sector_end <= offset || sector_start >= offset + size)
+			continue;
+		if (first < 0)
+			first = i;
+		last = i;
+	}
+	if (first < 0)
+		return ERROR_OK;
+
+	ahead->blank = calloc(last - first + 1, sizeof(*ahead->blank));
+	if (ahead->blank == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	if (bank->erase_skip_blank && bank->target->state == TARGET_HALTED)
+		flash_blank_check_sectors(bank, first, last, ahead->blank);
+
+	ahead->bank = bank;
+	ahead->first = first;
+	ahead->last = last;
+	ahead->num_sectors = last - first + 1;
+	ahead->sector = first;
+	ahead->start_ms = timeval_ms();
+
+	return flash_erase_ahead_poll(ahead);
+}
+
+/* Wait for the erase-ahead to complete.  After an error elsewhere, pass
+ * 'cancel' to only wait for the sector being erased. */
+static int flash_erase_ahead_finish(struct flash_erase_ahead *ahead, bool cancel)
+{
+	int retval = ERROR_OK;
+
+	if (cancel)
+		ahead->last = ahead->busy ? ahead->sector : ahead->sector - 1;
+
+	while (retval == ERROR_OK && (ahead->busy || ahead->sector <= ahead->last)) {
+		retval = flash_erase_ahead_poll(ahead);
+		if (retval == ERROR_OK && ahead->busy)
+			alive_sleep(1);
+	}
+
+	if (ahead->skipped)
+		LOG_INFO("flash bank %s: %d of %d sectors already blank, not erased",
+				ahead->bank->name, ahead->skipped, ahead->num_sectors);
+
+	free(ahead->blank);
+	ahead->blank = NULL;
+	return retval;
+}
+
+/* Smallest piece a run is split into while another bank is erased */
+#define FLASH_WRITE_CHUNK_SIZE	(64 * 1024)
+
+/* Write a run.  With an erase-ahead going on, write it in pieces and keep
+ * the erase going between them.  The pieces end on sector boundaries,
+ * which every driver accepts as the end of a write. */
+static int flash_write_run_data(struct flash_write_run *run,
+		struct flash_erase_ahead *ahead)
+{
+	struct flash_bank *bank = run->bank;
+	uint32_t start = run->address - bank->base;
+	uint32_t end = start + run->size;
+	uint32_t offset = start;
+	int sector = 0;
+
+	if (!ahead)
+		return flash_driver_write(bank, run->buffer, start, run->size);
+
+	while (offset < end) {
+		int retval = flash_erase_ahead_poll(ahead);
+		if (retval != ERROR_OK)
+			return retval;
+
+		uint32_t chunk_end = end;
+		for (; sector < bank->num_sectors; sector++) {
+			uint32_t sector_end = bank->sectors[sector].offset + bank->sectors[sector].size;
+			if (sector_end >= end)
+				break;
+			if (sector_end >= offset + FLASH_WRITE_CHUNK_SIZE) {
+				chunk_end = sector_end;
+				break;
 			}
 		}
 
-		retval = ERROR_OK;
+		retval = flash_driver_write(bank, run->buffer + (offset - start),
+				offset, chunk_end - offset);
+		if (retval != ERROR_OK)
+			return retval;
+		offset = chunk_end;
+	}
 
-		if (unlock)
-			retval = flash_unlock_address_range(target, run_address, run_size);
-		if (retval == ERROR_OK) {
-			if (erase) {
+	return ERROR_OK;
+}
+
+/*
+ * Runs are written in image order.  When erasing, the sectors of the next
+ * run are erased while the current one is written if the next run is in
+ * another bank whose driver can erase in the background, e.g. the second
+ * bank of a device with one flash controller per bank.
+ */
+int flash_write_unlock(struct target *target, struct image *image,
+	uint32_t *written, int erase, bool unlock)
+{
+	struct flash_write_run run, next;
+	struct flash_erase_ahead ahead;
+	bool erased_ahead = false;
+	int retval = ERROR_OK;
+
+	int section;
+	uint32_t section_offset;
+	int *padding;
+
+	section = 0;
+	section_offset = 0;
+
+	if (written)
+		*written = 0;
+
+	if (erase) {
+		/* assume all sectors need erasing - stops any problems
+		 * when flash_write is called multiple times */
+
+		flash_set_dirty();
+	}
+
+	free(flash_write_stats);
+	flash_write_stats = NULL;
+	flash_write_num_stats = 0;
+
+	/* allocate padding array */
+	padding = calloc(image->num_sections, sizeof(*padding));
+
+	/* This fn requires all sections to be in ascending order of addresses,
+	 * whereas an image can have sections out of order. */
+	struct imagesection **sections = malloc(sizeof(struct imagesection *) *
+			image->num_sections);
+	int i;
+	for (i = 0; i < image->num_sections; i++)
+		sections[i] = &image->sections[i];
+
+	qsort(sections, image->num_sections, sizeof(struct imagesection *),
+		compare_section);
+
+	retval = flash_write_next_run(target, image, sections, padding,
+			&section, &section_offset, erase, unlock, &run);
+
+	/* loop until we reach end of the image */
+	while (retval == ERROR_OK && run.bank) {
+		struct flash_write_bank_stats *bank_stats = flash_write_stats_get(run.bank);
+
+		if (!erased_ahead) {
+			if (unlock)
+				retval = flash_unlock_address_range(target, run.address, run.size);
+			if (retval == ERROR_OK && erase) {
+				int64_t t0 = timeval_ms();
 				/* calculate and erase sectors */
-				retval = flash_erase_address_range(target,
-						true, run_address, run_size);
+				retval = flash_iterate_address_range(target, "erase",
+						run.address, run.size, false,
+						&flash_driver_erase_dirty);
+				if (bank_stats)
+					bank_stats->erase_ms += timeval_ms() - t0;
 			}
 		}
 
+		/* start erasing the next run while this one is written */
+		memset(&ahead, 0, sizeof(ahead));
+		memset(&next, 0, sizeof(next));
+		if (retval == ERROR_OK)
+			retval = flash_write_next_run(target, image, sections, padding,
+					&section, &section_offset, erase, unlock, &next);
+		if (retval == ERROR_OK && erase && next.bank && next.bank != run.bank) {
+			if (unlock)
+				retval = flash_unlock_address_range(target, next.address, next.size);
+			if (retval == ERROR_OK)
+				retval = flash_erase_ahead_begin(&ahead, target, next.address, next.size);
+		}
+		erased_ahead = ahead.bank != NULL;
+
+		int64_t t1 = timeval_ms();
 		if (retval == ERROR_OK) {
 			/* write flash sectors */
-			retval = flash_driver_write(c, buffer, run_address - c->base, run_size);
+			retval = flash_write_run_data(&run, erased_ahead ? &ahead : NULL);
 		}
+		int64_t t2 = timeval_ms();
 
-		free(buffer);
+		if (bank_stats) {
+			bank_stats->write_ms += t2 - t1;
+			if (retval == ERROR_OK)
+				bank_stats->bytes += run.size;
+		}
+
+		if (erased_ahead) {
+			/* leave no erase running, even after a failure */
+			int erase_retval = flash_erase_ahead_finish(&ahead, retval != ERROR_OK);
+			if (retval == ERROR_OK)
+				retval = erase_retval;
+
+			struct flash_write_bank_stats *next_stats = flash_write_stats_get(next.bank);
+			if (next_stats) {
+				int64_t t3 = timeval_ms();
+				next_stats->erase_ms += t3 - ahead.start_ms;
+				next_stats->erase_overlap_ms += MIN(t2, t3) - ahead.start_ms;
+			}
+		}
+
+		free(run.buffer);
 
 		if (retval != ERROR_OK) {
 			/* abort operation */
-			goto done;
+			free(next.buffer);
+			break;
 		}
 
 		if (written != NULL)
-			*written += run_size;	/* add run size to total written counter */
+			*written += run.size;	/* add run size to total written counter */
+
+		run = next;
 	}
 
-done:
 	free(sections);
 	free(padding);
 
@@ -978,3 +1354,158 @@ struct flash_sector *alloc_block_array(uint32_t offset, uint32_t size, int num_b
 
 	return array;
 }
+
+/* Probe cache: one line per entry, "<key> <hex data>".  The key names the
+ * bank, its driver, the target's IDCODE and whatever device ID the driver
+ * has already read, so a cache hit only costs that ID read.  Without a JTAG
+ * IDCODE (e.g. over SWD) the driver's device ID is all that tells chips
+ * apart. */
+#define FLASH_PROBE_CACHE_MAX_DATA	1024
+#define FLASH_PROBE_CACHE_LINE		(2 * FLASH_PROBE_CACHE_MAX_DATA + 256)
+
+static char *flash_probe_cache_path;
+
+void flash_set_probe_cache(const char *path)
+{
+	free(flash_probe_cache_path);
+	flash_probe_cache_path = path ? strdup(path) : NULL;
+}
+
+const char *flash_get_probe_cache(void)
+{
+	return flash_probe_cache_path;
+}
+
+static char *flash_probe_cache_key(struct flash_bank *bank, const char *key)
+{
+	struct jtag_tap *tap = bank->target->tap;
+	uint32_t idcode = (tap && tap->hasidcode) ? tap->idcode : 0;
+
+	char *full_key = alloc_printf("%s/%s/%08" PRIx32 "/%s", bank->name,
+			bank->driver->name, idcode, key);
+	if (full_key && strpbrk(full_key, " \t\r\n")) {
+		free(full_key);
+		return NULL;
+	}
+	return full_key;
+}
+
+int flash_probe_cache_load(struct flash_bank *bank, const char *key,
+		uint8_t *data, size_t *size)
+{
+	if (!flash_probe_cache_path)
+		return ERROR_FAIL;
+
+	char *full_key = flash_probe_cache_key(bank, key);
+	if (!full_key)
+		return ERROR_FAIL;
+
+	FILE *f = fopen(flash_probe_cache_path, "r");
+	if (!f) {
+		free(full_key);
+		return ERROR_FAIL;
+	}
+
+	int retval = ERROR_FAIL;
+	size_t key_len = strlen(full_key);
+	char *line = malloc(FLASH_PROBE_CACHE_LINE);
+	while (line && fgets(line, FLASH_PROBE_CACHE_LINE, f)) {
+		if (strncmp(line, full_key, key_len) || line[key_len] != ' ')
+			continue;
+
+		const char *hex = line + key_len + 1;
+		size_t len = strcspn(hex, "\r\n") / 2;
+		if (len <= *size && unhexify(data, hex, len) == len) {
+			*size = len;
+			retval = ERROR_OK;
+		}
+		break;
+	}
+
+	free(line);
+	fclose(f);
+	free(full_key);
+
+	if (retval == ERROR_OK)
+		LOG_DEBUG("flash bank %s: using cached probe data for %s", bank->name, key);
+	return retval;
+}
+
+int flash_probe_cache_store(struct flash_bank *bank, const char *key,
+		const uint8_t *data, size_t size)
+{
+	if (!flash_probe_cache_path)
+		return ERROR_OK;
+	if (size > FLASH_PROBE_CACHE_MAX_DATA)
+		return ERROR_FAIL;
+
+	char *full_key = flash_probe_cache_key(bank, key);
+	if (!full_key)
+		return ERROR_FAIL;
+
+	/* keep every other entry, drop the stale one(s) for this key prefix */
+	int retval = ERROR_OK;
+	char *prefix = alloc_printf("%s/%s/", bank->name, bank->driver->name);
+	char *tmp_path = alloc_printf("%s.tmp", flash_probe_cache_path);
+	char *kept = NULL;
+	size_t kept_len = 0;
+	char *line = malloc(FLASH_PROBE_CACHE_LINE);
+	if (!prefix || !tmp_path || !line) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+	}
+
+	FILE *f = NULL;
+	if (retval == ERROR_OK)
+		f = fopen(flash_probe_cache_path, "r");
+	while (f && fgets(line, FLASH_PROBE_CACHE_LINE, f)) {
+		if (strncmp(line, prefix, strlen(prefix)) == 0)
+			continue;
+		size_t len = strlen(line);
+		char *n = realloc(kept, kept_len + len + 1);
+		if (!n) {
+			/* rewriting now would lose the entries not read yet */
+			LOG_ERROR("Out of memory");
+			retval = ERROR_FAIL;
+			break;
+		}
+		kept = n;
+		memcpy(kept + kept_len, line, len + 1);
+		kept_len += len;
+	}
+	if (f)
+		fclose(f);
+
+	/* write a new file and move it over the old one, so that a failed
+	 * write never leaves a truncated cache behind */
+	if (retval == ERROR_OK) {
+		retval = ERROR_FAIL;
+		f = fopen(tmp_path, "w");
+		if (f) {
+			hexify(line, data, size, FLASH_PROBE_CACHE_LINE);
+			if ((kept_len == 0 || fwrite(kept, 1, kept_len, f) == kept_len)
+					&& fprintf(f, "%s %s\n", full_key, line) > 0)
+				retval = ERROR_OK;
+			if (fclose(f) != 0)
+				retval = ERROR_FAIL;
+#ifdef _WIN32
+			/* rename() does not replace an existing file there */
+			if (retval == ERROR_OK)
+				remove(flash_probe_cache_path);
+#endif
+			if (retval == ERROR_OK && rename(tmp_path, flash_probe_cache_path) != 0)
+				retval = ERROR_FAIL;
+			if (retval != ERROR_OK)
+				remove(tmp_path);
+		}
+		if (retval != ERROR_OK)
+			LOG_WARNING("unable to update flash probe cache '%s'", flash_probe_cache_path);
+	}
+
+	free(kept);
+	free(line);
+	free(tmp_path);
+	free(prefix);
+	free(full_key);
+	return retval;
+}
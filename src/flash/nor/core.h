@@ -107,6 +107,10 @@ struct flash_bank {
 	 * erased value. Defaults to 0xFF. */
 	uint8_t default_padded_value;
 
+	/** Blank check sectors before erasing them during an image write
+	 * and erase only the ones which are not blank. Defaults to false. */
+	bool erase_skip_blank;
+
 	/** Required alignment of flash write start address.
 	 * Default 0, no alignment. Can be any power of two or FLASH_WRITE_ALIGN_SECTOR */
 	uint32_t write_start_alignment;
@@ -192,6 +196,11 @@ int flash_write(struct target *target,
  */
 void flash_set_dirty(void);
 
+/** Sets (or with NULL clears) the file used to cache probe results. */
+void flash_set_probe_cache(const char *path);
+/** @returns The probe cache file name, or NULL if caching is disabled. */
+const char *flash_get_probe_cache(void);
+
 /** @returns The number of flash banks currently defined. */
 int flash_get_bank_count(void);
 
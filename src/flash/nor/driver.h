@@ -106,6 +106,32 @@ struct flash_driver {
 	 */
 	int (*erase)(struct flash_bank *bank, int first, int last);
 
+	/**
+	 * Start erasing one sector and return without waiting for the
+	 * erase to complete, see flash_driver_s::erase_poll.  Writing an
+	 * image uses this to erase one bank while programming another, so
+	 * only implement it where the erase of a bank does not get in the
+	 * way of programming the other banks, e.g. one flash controller per
+	 * bank.  Optional, set to NULL if not implemented.
+	 *
+	 * @param bank The bank to be erased.
+	 * @param sector The number of the sector to erase.
+	 * @returns ERROR_OK if the erase was started; otherwise, an error code.
+	 */
+	int (*erase_start)(struct flash_bank *bank, int sector);
+
+	/**
+	 * Check whether the erase started by flash_driver_s::erase_start
+	 * has completed.
+	 *
+	 * @param bank The bank being erased.
+	 * @param sector The number of the sector being erased.
+	 * @param done Set to true once the erase has completed.
+	 * @returns ERROR_OK if successful; otherwise, an error code, also
+	 * when the erase completed with an error.
+	 */
+	int (*erase_poll)(struct flash_bank *bank, int sector, bool *done);
+
 	/**
 	 * Bank/sector protection routine (target-specific).
 	 *
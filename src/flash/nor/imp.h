@@ -46,4 +46,33 @@ int flash_driver_read(struct flash_bank *bank,
 int flash_write_unlock(struct target *target, struct image *image,
 		uint32_t *written, int erase, bool unlock);
 
+/** Time spent on one bank by the last flash_write_unlock() */
+struct flash_write_bank_stats {
+	struct flash_bank *bank;
+	uint32_t bytes;			/**< bytes written */
+	int64_t erase_ms;		/**< from the start to the end of erasing */
+	int64_t erase_overlap_ms;	/**< part of erase_ms spent writing another bank */
+	int64_t write_ms;		/**< time spent writing */
+};
+
+/** @returns The number of banks the last flash_write_unlock() wrote to,
+ * with @a stats set to their statistics. */
+int flash_write_get_stats(const struct flash_write_bank_stats **stats);
+
+/**
+ * Look up probe results saved by flash_probe_cache_store() in an earlier
+ * session.  The @a key must identify the device (e.g. its ID registers),
+ * it is combined with the bank name, driver name and target IDCODE.
+ * @a size holds the capacity of @a data on entry and the number of bytes
+ * restored on success.
+ * @returns ERROR_OK only if a valid entry fitting in @a data exists; any
+ * failure means the driver has to do a full probe.
+ */
+int flash_probe_cache_load(struct flash_bank *bank, const char *key,
+		uint8_t *data, size_t *size);
+/** Save probe results for @a bank, replacing its previous entry.
+ * Does nothing unless a cache file has been set with 'flash probe_cache'. */
+int flash_probe_cache_store(struct flash_bank *bank, const char *key,
+		const uint8_t *data, size_t size);
+
 #endif /* OPENOCD_FLASH_NOR_IMP_H */
@@ -503,6 +503,58 @@ flash_lock:
 	return (retval == ERROR_OK) ? retval2 : retval;
 }
 
+/* Each bank has its own flash controller, so one bank can be erased
+ * while the other one is programmed. */
+static int stm32x_erase_start(struct flash_bank *bank, int sector)
+{
+	struct stm32h7x_flash_bank *stm32x_info = bank->driver_priv;
+
+	if (bank->target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	int retval = stm32x_unlock_reg(bank);
+	if (retval == ERROR_OK)
+		retval = stm32x_write_flash_reg(bank, FLASH_CR,
+				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64, sector));
+	if (retval == ERROR_OK)
+		retval = stm32x_write_flash_reg(bank, FLASH_CR,
+				stm32x_info->part_info->compute_flash_cr(FLASH_SER | FLASH_PSIZE_64 | FLASH_START, sector));
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error erase sector %d", sector);
+		stm32x_lock_reg(bank);
+	}
+
+	return retval;
+}
+
+static int stm32x_erase_poll(struct flash_bank *bank, int sector, bool *done)
+{
+	uint32_t status;
+	int retval, retval2;
+
+	retval = stm32x_get_flash_status(bank, &status);
+	if (retval != ERROR_OK)
+		return retval;
+
+	*done = (status & FLASH_QW) == 0;
+	if (!*done)
+		return ERROR_OK;
+
+	/* Clear error + EOP flags but report errors */
+	if (status & FLASH_ERROR) {
+		LOG_ERROR("erase operation error sector %d, status: 0x%" PRIx32, sector, status);
+		retval = ERROR_FAIL;
+		/* If this operation fails, we ignore it and report the original retval */
+		stm32x_write_flash_reg(bank, FLASH_CCR, status);
+	}
+
+	retval2 = stm32x_lock_reg(bank);
+	if (retval2 != ERROR_OK)
+		LOG_ERROR("error during the lock of flash");
+
+	return (retval == ERROR_OK) ? retval2 : retval;
+}
+
 static int stm32x_protect(struct flash_bank *bank, int set, int first, int last)
 {
 	struct target *target = bank->target;
@@ -1181,6 +1233,8 @@ const struct flash_driver stm32h7x_flash = {
 	.commands = stm32x_command_handlers,
 	.flash_bank_command = stm32x_flash_bank_command,
 	.erase = stm32x_erase,
+	.erase_start = stm32x_erase_start,
+	.erase_poll = stm32x_erase_poll,
 	.protect = stm32x_protect,
 	.write = stm32x_write,
 	.read = default_flash_read,
@@ -473,6 +473,27 @@ COMMAND_HANDLER(handle_flash_write_image_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_flash_write_stats_command)
+{
+	const struct flash_write_bank_stats *stats;
+
+	if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	int num = flash_write_get_stats(&stats);
+	for (int i = 0; i < num; i++) {
+		const struct flash_write_bank_stats *s = &stats[i];
+		float kbps = s->write_ms ? s->bytes / 1.024f / s->write_ms : 0;
+
+		command_print(CMD, "%s: erase %.3fs (%.3fs while writing another bank), "
+				"wrote %" PRIu32 " bytes in %.3fs (%0.3f KiB/s)",
+				s->bank->name, s->erase_ms / 1000.0, s->erase_overlap_ms / 1000.0,
+				s->bytes, s->write_ms / 1000.0, kbps);
+	}
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_flash_fill_command)
 {
 	target_addr_t address;
@@ -1034,6 +1055,39 @@ COMMAND_HANDLER(handle_flash_padded_value_command)
 	return retval;
 }
 
+COMMAND_HANDLER(handle_flash_erase_skip_blank_command)
+{
+	if (CMD_ARGC < 1 || CMD_ARGC > 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	struct flash_bank *p;
+	int retval = CALL_COMMAND_HANDLER(flash_command_get_bank, 0, &p);
+	if (ERROR_OK != retval)
+		return retval;
+
+	if (CMD_ARGC == 2)
+		COMMAND_PARSE_ON_OFF(CMD_ARGV[1], p->erase_skip_blank);
+
+	command_print(CMD, "Blank sector erase skipping is %s for flash bank %u",
+			p->erase_skip_blank ? "on" : "off", p->bank_number);
+
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_flash_probe_cache_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		flash_set_probe_cache(strcmp(CMD_ARGV[0], "off") ? CMD_ARGV[0] : NULL);
+
+	const char *path = flash_get_probe_cache();
+	command_print(CMD, "flash probe cache: %s", path ? path : "off");
+
+	return ERROR_OK;
+}
+
 static const struct command_registration flash_exec_command_handlers[] = {
 	{
 		.name = "probe",
@@ -1148,6 +1202,14 @@ static const struct command_registration flash_exec_command_handlers[] = {
 			"and/or erase the region to be used.  Allow optional "
 			"offset from beginning of bank (defaults to zero)",
 	},
+	{
+		.name = "write_stats",
+		.handler = handle_flash_write_stats_command,
+		.mode = COMMAND_EXEC,
+		.usage = "",
+		.help = "Show the per bank erase and write times of the last "
+			"image written to flash.",
+	},
 	{
 		.name = "read_bank",
 		.handler = handle_flash_read_bank_command,
@@ -1182,6 +1244,14 @@ static const struct command_registration flash_exec_command_handlers[] = {
 		.usage = "bank_id value",
 		.help = "Set default flash padded value",
 	},
+	{
+		.name = "erase_skip_blank",
+		.handler = handle_flash_erase_skip_blank_command,
+		.mode = COMMAND_EXEC,
+		.usage = "bank_id ['on'|'off']",
+		.help = "Blank check sectors before erasing them in "
+			"'flash write_image erase' and skip the blank ones.",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -1359,6 +1429,14 @@ static const struct command_registration flash_config_command_handlers[] = {
 		.jim_handler = jim_flash_list,
 		.help = "Returns a list of details about the flash banks.",
 	},
+	{
+		.name = "probe_cache",
+		.mode = COMMAND_ANY,
+		.handler = handle_flash_probe_cache_command,
+		.help = "Set the file used to cache flash probe results "
+			"between sessions, or 'off'.",
+		.usage = "[filename|'off']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 static const struct command_registration flash_command_handlers[] = {
@@ -147,31 +147,26 @@ void script_debug(Jim_Interp *interp, unsigned int argc, Jim_Obj * const *argv)
 	free(dbg);
 }
 
-static void script_command_args_free(char **words, unsigned nwords)
+/* Most commands take a handful of arguments; those get their argument
+ * vector on the stack. */
+#define SCRIPT_COMMAND_STACK_ARGS	16
+
+/* The words borrow the string representation of the Jim objects, which
+ * the interpreter keeps alive for the duration of the command. */
+static const char **script_command_args_get(unsigned argc, Jim_Obj * const *argv,
+		const char **stack_words)
 {
-	for (unsigned i = 0; i < nwords; i++)
-		free(words[i]);
-	free(words);
-}
-
-static char **script_command_args_alloc(
-	unsigned argc, Jim_Obj * const *argv, unsigned *nwords)
-{
-	char **words = malloc(argc * sizeof(char *));
-	if (NULL == words)
-		return NULL;
+	const char **words = stack_words;
 
-	unsigned i;
-	for (i = 0; i < argc; i++) {
-		int len;
-		const char *w = Jim_GetString(argv[i], &len);
-		words[i] = strdup(w);
-		if (words[i] == NULL) {
-			script_command_args_free(words, i);
+	if (argc > SCRIPT_COMMAND_STACK_ARGS) {
+		words = malloc(argc * sizeof(char *));
+		if (NULL == words)
 			return NULL;
-		}
 	}
-	*nwords = i;
+
+	for (unsigned i = 0; i < argc; i++)
+		words[i] = Jim_GetString(argv[i], NULL);
+
 	return words;
 }
 
@@ -192,21 +187,46 @@ struct command_context *current_command_context(Jim_Interp *interp)
 	return cmd_ctx;
 }
 
+/* Targets are polled before commands invoked from Tcl, but at most once
+ * per script_poll_interval_ms and never inside a script_batch body. */
+static unsigned int script_poll_interval_ms = 10;
+static int64_t script_poll_last_ms;
+static unsigned int script_batch_depth;
+static uint64_t script_polls_run;
+static uint64_t script_polls_skipped;
+
+static void script_command_poll(void)
+{
+	int64_t now = timeval_ms();
+
+	if (script_batch_depth == 0 &&
+			now - script_poll_last_ms >= (int64_t)script_poll_interval_ms) {
+		script_poll_last_ms = now;
+		script_polls_run++;
+		target_call_timer_callbacks_now();
+		LOG_USER_N("%s", "");	/* Keep GDB connection alive*/
+		return;
+	}
+
+	script_polls_skipped++;
+	keep_alive();
+}
+
 static int script_command_run(Jim_Interp *interp,
 	int argc, Jim_Obj * const *argv, struct command *c)
 {
-	target_call_timer_callbacks_now();
-	LOG_USER_N("%s", "");	/* Keep GDB connection alive*/
+	script_command_poll();
 
-	unsigned nwords;
-	char **words = script_command_args_alloc(argc, argv, &nwords);
+	const char *stack_words[SCRIPT_COMMAND_STACK_ARGS];
+	const char **words = script_command_args_get(argc, argv, stack_words);
 	if (NULL == words)
 		return JIM_ERR;
 
 	struct command_context *cmd_ctx = current_command_context(interp);
-	int retval = run_command(cmd_ctx, c, (const char **)words, nwords);
+	int retval = run_command(cmd_ctx, c, words, argc);
 
-	script_command_args_free(words, nwords);
+	if (words != stack_words)
+		free(words);
 	return command_retval_set(interp, retval);
 }
 
@@ -241,6 +261,53 @@ static struct command *command_find(struct command *head, const char *name)
 	return NULL;
 }
 
+/* Commands are also indexed by (parent, name), so that dispatching
+ * e.g. "<target> mdw" does not walk the sorted sibling lists. */
+#define COMMAND_HASH_SIZE	1024
+
+static struct command *command_hash[COMMAND_HASH_SIZE];
+
+static unsigned command_hash_index(const struct command *parent, const char *name)
+{
+	/* FNV-1a over the name, seeded with the parent address */
+	uint32_t h = 2166136261u ^ (uint32_t)(uintptr_t)parent;
+	while (*name) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619u;
+	}
+	return h & (COMMAND_HASH_SIZE - 1);
+}
+
+static void command_hash_add(struct command *c)
+{
+	unsigned i = command_hash_index(c->parent, c->name);
+	c->hash_next = command_hash[i];
+	command_hash[i] = c;
+}
+
+static void command_hash_remove(struct command *c)
+{
+	/* command_new() failed before hashing it */
+	if (!c->name)
+		return;
+
+	struct command **p = &command_hash[command_hash_index(c->parent, c->name)];
+	while (*p && *p != c)
+		p = &(*p)->hash_next;
+	if (*p)
+		*p = c->hash_next;
+}
+
+static struct command *command_find_child(struct command *parent, const char *name)
+{
+	struct command *c = command_hash[command_hash_index(parent, name)];
+	for (; c; c = c->hash_next) {
+		if (c->parent == parent && strcmp(c->name, name) == 0)
+			return c;
+	}
+	return NULL;
+}
+
 struct command *command_find_in_context(struct command_context *cmd_ctx,
 	const char *name)
 {
@@ -289,6 +356,8 @@ static void command_free(struct command *c)
 		command_free(tmp);
 	}
 
+	command_hash_remove(c);
+
 	free(c->name);
 	free(c->help);
 	free(c->usage);
@@ -334,6 +403,7 @@ static struct command *command_new(struct command_context *cmd_ctx,
 	c->mode = cr->mode;
 
 	command_add_child(command_list_for_parent(cmd_ctx, parent), c);
+	command_hash_add(c);
 
 	return c;
 
@@ -956,6 +1026,22 @@ COMMAND_HANDLER(handle_help_command)
 	return retval;
 }
 
+/* descend from *out into its subcommands as far as argv allows */
+static int command_subcommand_find(unsigned argc, Jim_Obj *const *argv,
+	struct command **out)
+{
+	while (argc > 0 && (*out)->children) {
+		const char *cmd_name = Jim_GetString(argv[0], NULL);
+		struct command *c = command_find_child(*out, cmd_name);
+		if (NULL == c)
+			break;
+		*out = c;
+		argc--;
+		argv++;
+	}
+	return argc;
+}
+
 static int command_unknown_find(unsigned argc, Jim_Obj *const *argv,
 	struct command *head, struct command **out)
 {
@@ -966,7 +1052,7 @@ static int command_unknown_find(unsigned argc, Jim_Obj *const *argv,
 	if (NULL == c)
 		return argc;
 	*out = c;
-	return command_unknown_find(--argc, ++argv, (*out)->children, out);
+	return command_subcommand_find(--argc, ++argv, out);
 }
 
 static char *alloc_concatenate_strings(int argc, Jim_Obj * const *argv)
@@ -1033,8 +1119,14 @@ static int command_unknown(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
 	script_debug(interp, argc, argv);
 
 	struct command_context *cmd_ctx = current_command_context(interp);
-	struct command *c = cmd_ctx->commands;
-	int remaining = command_unknown_find(argc, argv, c, &c);
+	struct command *c = command_find_child(NULL, Jim_GetString(argv[0], NULL));
+	int remaining;
+	if (c) {
+		remaining = command_subcommand_find(argc - 1, argv + 1, &c);
+	} else {
+		c = cmd_ctx->commands;
+		remaining = command_unknown_find(argc, argv, c, &c);
+	}
 	/* if nothing could be consumed, then it's really an unknown command */
 	if (remaining == argc) {
 		const char *cmd = Jim_GetString(argv[0], NULL);
@@ -1210,6 +1302,51 @@ COMMAND_HANDLER(handle_sleep_command)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(handle_script_poll_interval_command)
+{
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (CMD_ARGC == 1)
+		COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], script_poll_interval_ms);
+
+	command_print(CMD, "%u", script_poll_interval_ms);
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_script_poll_stats_command)
+{
+	if (CMD_ARGC == 1 && strcmp(CMD_ARGV[0], "reset") == 0) {
+		script_polls_run = 0;
+		script_polls_skipped = 0;
+		return ERROR_OK;
+	} else if (CMD_ARGC != 0)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	command_print(CMD, "polls run: %" PRIu64 ", skipped: %" PRIu64,
+			script_polls_run, script_polls_skipped);
+	return ERROR_OK;
+}
+
+/* Evaluate a script with polling suspended; the first command after the
+ * outermost batch polls again. */
+static int jim_script_batch(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	if (argc != 2) {
+		Jim_WrongNumArgs(interp, 1, argv, "script");
+		return JIM_ERR;
+	}
+
+	script_batch_depth++;
+	int retcode = Jim_EvalObj(interp, argv[1]);
+	script_batch_depth--;
+
+	if (script_batch_depth == 0)
+		script_poll_last_ms = 0;
+
+	return retcode;
+}
+
 static const struct command_registration command_subcommand_handlers[] = {
 	{
 		.name = "mode",
@@ -1274,6 +1411,30 @@ static const struct command_registration command_builtin_handlers[] = {
 			"\"busy\" will busy wait instead (avoid this).",
 		.usage = "milliseconds ['busy']",
 	},
+	{
+		.name = "script_poll_interval",
+		.handler = handle_script_poll_interval_command,
+		.mode = COMMAND_ANY,
+		.help = "Minimum time between target polls triggered by "
+			"commands run from Tcl; 0 polls before every command.",
+		.usage = "[milliseconds]",
+	},
+	{
+		.name = "script_poll_stats",
+		.handler = handle_script_poll_stats_command,
+		.mode = COMMAND_ANY,
+		.help = "Show or reset the number of target polls run and "
+			"skipped for commands run from Tcl.",
+		.usage = "['reset']",
+	},
+	{
+		.name = "script_batch",
+		.mode = COMMAND_ANY,
+		.jim_handler = jim_script_batch,
+		.help = "Evaluate a script without polling targets between "
+			"its commands.",
+		.usage = "script",
+	},
 	{
 		.name = "help",
 		.handler = handle_help_command,
@@ -193,6 +193,8 @@ struct command {
 		 * jim_handler_data for any handler specific data */
 	enum command_mode mode;
 	struct command *next;
+	/* chain in the subcommand lookup table, keyed by parent and name */
+	struct command *hash_next;
 };
 
 /*
@@ -30,12 +30,18 @@
 #include "configuration.h"
 #include "fileio.h"
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
 struct fileio {
 	char *url;
 	size_t size;
 	enum fileio_type type;
 	enum fileio_access access;
 	FILE *file;
+	/* read-only mapping of the whole file, see fileio_map() */
+	void *map;
 };
 
 static inline int fileio_close_local(struct fileio *fileio)
@@ -127,6 +133,7 @@ int fileio_open(struct fileio **fileio, const char *url,
 	tmp->type = type;
 	tmp->access = access_type;
 	tmp->url = strdup(url);
+	tmp->map = NULL;
 
 	retval = fileio_open_local(tmp);
 
@@ -145,6 +152,11 @@ int fileio_close(struct fileio *fileio)
 {
 	int retval;
 
+#ifdef HAVE_SYS_MMAN_H
+	if (fileio->map)
+		munmap(fileio->map, fileio->size);
+#endif
+
 	retval = fileio_close_local(fileio);
 
 	free(fileio->url);
@@ -153,6 +165,36 @@ int fileio_close(struct fileio *fileio)
 	return retval;
 }
 
+/**
+ * Maps a file opened for reading into memory, so its contents can be used
+ * without copying.  The mapping covers fileio_size() bytes and stays valid
+ * until fileio_close().
+ * @returns ERROR_FILEIO_OPERATION_NOT_SUPPORTED if the file can't be mapped
+ * (e.g. no mmap() on this host); callers then use fileio_read().
+ */
+int fileio_map(struct fileio *fileio, const uint8_t **data)
+{
+#ifdef HAVE_SYS_MMAN_H
+	if (!fileio->map) {
+		if (fileio->access != FILEIO_READ || fileio->size == 0)
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+
+		void *map = mmap(NULL, fileio->size, PROT_READ, MAP_PRIVATE,
+				fileno(fileio->file), 0);
+		if (map == MAP_FAILED) {
+			LOG_DEBUG("couldn't map %s: %s", fileio->url, strerror(errno));
+			return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+		}
+		fileio->map = map;
+	}
+
+	*data = fileio->map;
+	return ERROR_OK;
+#else
+	return ERROR_FILEIO_OPERATION_NOT_SUPPORTED;
+#endif
+}
+
 int fileio_feof(struct fileio *fileio)
 {
 	return feof(fileio->file);
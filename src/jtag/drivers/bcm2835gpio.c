@@ -51,6 +51,7 @@ static volatile uint32_t *pio_base;
 
 static bb_value_t bcm2835gpio_read(void);
 static int bcm2835gpio_write(int tck, int tms, int tdi);
+static int bcm2835gpio_write_vector(const uint8_t *states, size_t count, uint8_t *in);
 
 static int bcm2835_swdio_read(void);
 static void bcm2835_swdio_drive(bool is_output);
@@ -61,6 +62,7 @@ static int bcm2835gpio_quit(void);
 static struct bitbang_interface bcm2835gpio_bitbang = {
 	.read = bcm2835gpio_read,
 	.write = bcm2835gpio_write,
+	.write_vector = bcm2835gpio_write_vector,
 	.swdio_read = bcm2835_swdio_read,
 	.swdio_drive = bcm2835_swdio_drive,
 	.blink = NULL
@@ -122,6 +124,55 @@ static int bcm2835gpio_swd_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+/* GPIO_SET/GPIO_CLR masks for every TCK/TMS/TDI combination of a vector
+ * entry, and the input to sample; filled in once the mode is known */
+static uint32_t vector_set[8];
+static uint32_t vector_clear[8];
+static uint32_t vector_in;
+
+static void bcm2835gpio_vector_setup(void)
+{
+	for (unsigned int s = 0; s < 8; s++) {
+		int tck = !!(s & BB_VEC_TCK);
+		int tms = !!(s & BB_VEC_TMS);
+		int tdi = !!(s & BB_VEC_TDI);
+
+		if (swd_mode) {
+			vector_set[s] = tck<<swclk_gpio | tdi<<swdio_gpio;
+			vector_clear[s] = !tck<<swclk_gpio | !tdi<<swdio_gpio;
+		} else {
+			vector_set[s] = tck<<tck_gpio | tms<<tms_gpio | tdi<<tdi_gpio;
+			vector_clear[s] = !tck<<tck_gpio | !tms<<tms_gpio | !tdi<<tdi_gpio;
+		}
+	}
+	vector_in = 1 << (swd_mode ? swdio_gpio : tdo_gpio);
+}
+
+static int bcm2835gpio_write_vector(const uint8_t *states, size_t count, uint8_t *in)
+{
+	unsigned int n = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		unsigned int s = states[i] & (BB_VEC_TCK | BB_VEC_TMS | BB_VEC_TDI);
+
+		GPIO_SET = vector_set[s];
+		GPIO_CLR = vector_clear[s];
+
+		for (unsigned int j = 0; j < jtag_delay; j++)
+			asm volatile ("");
+
+		if (states[i] & BB_VEC_SAMPLE) {
+			if (GPIO_LEV & vector_in)
+				in[n / 8] |= 1 << (n % 8);
+			else
+				in[n / 8] &= ~(1 << (n % 8));
+			n++;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 /* (1) assert or (0) deassert reset lines */
 static int bcm2835gpio_reset(int trst, int srst)
 {
@@ -533,6 +584,8 @@ static int bcm2835gpio_init(void)
 		  "tdo %d trst %d srst %d", tck_gpio_mode, tms_gpio_mode,
 		  tdi_gpio_mode, tdo_gpio_mode, trst_gpio_mode, srst_gpio_mode);
 
+	bcm2835gpio_vector_setup();
+
 	if (swd_mode) {
 		bcm2835gpio_bitbang.write = bcm2835gpio_swd_write;
 		bitbang_switch_to_swd();
@@ -44,6 +44,68 @@ static void bitbang_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay
 
 struct bitbang_interface *bitbang_interface;
 
+/* Pin states queued for bitbang_interface->write_vector() */
+#define BB_VEC_FLUSH_SIZE	(64 * 1024)
+
+static uint8_t *bb_vec;
+static size_t bb_vec_len;
+static size_t bb_vec_size;
+static unsigned int bb_vec_samples;
+
+static int bitbang_vec_add(uint8_t state)
+{
+	if (bb_vec_len == bb_vec_size) {
+		size_t size = bb_vec_size ? bb_vec_size * 2 : BB_VEC_FLUSH_SIZE;
+		uint8_t *vec = realloc(bb_vec, size);
+		if (vec == NULL)
+			return ERROR_FAIL;
+		bb_vec = vec;
+		bb_vec_size = size;
+	}
+
+	bb_vec[bb_vec_len++] = state;
+	if (state & BB_VEC_SAMPLE)
+		bb_vec_samples++;
+	return ERROR_OK;
+}
+
+/* Hand the queued pin states to the driver. Sampled bits land in @a in,
+ * which must be given whenever samples are pending. */
+static int bitbang_flush(uint8_t *in)
+{
+	if (bb_vec_len == 0)
+		return ERROR_OK;
+
+	assert(in || bb_vec_samples == 0);
+
+	int retval = bitbang_interface->write_vector(bb_vec, bb_vec_len, in);
+	bb_vec_len = 0;
+	bb_vec_samples = 0;
+	return retval;
+}
+
+static int bitbang_write(int tck, int tms, int tdi)
+{
+	if (!bitbang_interface->write_vector)
+		return bitbang_interface->write(tck, tms, tdi);
+
+	/* bound the queue while nothing waits for sampled data */
+	if (bb_vec_samples == 0 && bb_vec_len >= BB_VEC_FLUSH_SIZE) {
+		if (bitbang_flush(NULL) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
+	return bitbang_vec_add((tck ? BB_VEC_TCK : 0) | (tms ? BB_VEC_TMS : 0) |
+			(tdi ? BB_VEC_TDI : 0));
+}
+
+/* Like bitbang_write(), and sample the input right after it */
+static int bitbang_write_sample(int tck, int tms, int tdi)
+{
+	return bitbang_vec_add((tck ? BB_VEC_TCK : 0) | (tms ? BB_VEC_TMS : 0) |
+			(tdi ? BB_VEC_TDI : 0) | BB_VEC_SAMPLE);
+}
+
 /* DANGER!!!! clock absolutely *MUST* be 0 in idle or reset won't work!
  *
  * Set this to 1 and str912 reset halt will fail.
@@ -79,12 +141,12 @@ static int bitbang_state_move(int skip)
 
 	for (i = skip; i < tms_count; i++) {
 		tms = (tms_scan >> i) & 1;
-		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
+		if (bitbang_write(0, tms, 0) != ERROR_OK)
 			return ERROR_FAIL;
-		if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+		if (bitbang_write(1, tms, 0) != ERROR_OK)
 			return ERROR_FAIL;
 	}
-	if (bitbang_interface->write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
+	if (bitbang_write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
 		return ERROR_FAIL;
 
 	tap_set_state(tap_get_end_state());
@@ -105,12 +167,12 @@ static int bitbang_execute_tms(struct jtag_command *cmd)
 	int tms = 0;
 	for (unsigned i = 0; i < num_bits; i++) {
 		tms = ((bits[i/8] >> (i % 8)) & 1);
-		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
+		if (bitbang_write(0, tms, 0) != ERROR_OK)
 			return ERROR_FAIL;
-		if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+		if (bitbang_write(1, tms, 0) != ERROR_OK)
 			return ERROR_FAIL;
 	}
-	if (bitbang_interface->write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
+	if (bitbang_write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
 		return ERROR_FAIL;
 
 	return ERROR_OK;
@@ -135,9 +197,9 @@ static int bitbang_path_move(struct pathmove_command *cmd)
 			exit(-1);
 		}
 
-		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
+		if (bitbang_write(0, tms, 0) != ERROR_OK)
 			return ERROR_FAIL;
-		if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+		if (bitbang_write(1, tms, 0) != ERROR_OK)
 			return ERROR_FAIL;
 
 		tap_set_state(cmd->path[state_count]);
@@ -145,7 +207,7 @@ static int bitbang_path_move(struct pathmove_command *cmd)
 		num_states--;
 	}
 
-	if (bitbang_interface->write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
+	if (bitbang_write(CLOCK_IDLE(), tms, 0) != ERROR_OK)
 		return ERROR_FAIL;
 
 	tap_set_end_state(tap_get_state());
@@ -167,12 +229,12 @@ static int bitbang_runtest(int num_cycles)
 
 	/* execute num_cycles */
 	for (i = 0; i < num_cycles; i++) {
-		if (bitbang_interface->write(0, 0, 0) != ERROR_OK)
+		if (bitbang_write(0, 0, 0) != ERROR_OK)
 			return ERROR_FAIL;
-		if (bitbang_interface->write(1, 0, 0) != ERROR_OK)
+		if (bitbang_write(1, 0, 0) != ERROR_OK)
 			return ERROR_FAIL;
 	}
-	if (bitbang_interface->write(CLOCK_IDLE(), 0, 0) != ERROR_OK)
+	if (bitbang_write(CLOCK_IDLE(), 0, 0) != ERROR_OK)
 		return ERROR_FAIL;
 
 	/* finish in end_state */
@@ -191,9 +253,9 @@ static int bitbang_stableclocks(int num_cycles)
 
 	/* send num_cycles clocks onto the cable */
 	for (i = 0; i < num_cycles; i++) {
-		if (bitbang_interface->write(1, tms, 0) != ERROR_OK)
+		if (bitbang_write(1, tms, 0) != ERROR_OK)
 			return ERROR_FAIL;
-		if (bitbang_interface->write(0, tms, 0) != ERROR_OK)
+		if (bitbang_write(0, tms, 0) != ERROR_OK)
 			return ERROR_FAIL;
 	}
 
@@ -219,8 +281,29 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		bitbang_end_state(saved_end_state);
 	}
 
+	if (bitbang_interface->write_vector) {
+		for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
+			int tms = (bit_cnt == scan_size-1) ? 1 : 0;
+			int tdi = (type != SCAN_IN) && (buffer[bit_cnt/8] & (1 << (bit_cnt % 8)));
+			int retval;
+
+			if (type != SCAN_OUT)
+				retval = bitbang_write_sample(0, tms, tdi);
+			else
+				retval = bitbang_write(0, tms, tdi);
+			if (retval != ERROR_OK)
+				return ERROR_FAIL;
+			if (bitbang_write(1, tms, tdi) != ERROR_OK)
+				return ERROR_FAIL;
+		}
+
+		/* the output bits are already queued, captured ones replace them */
+		if (type != SCAN_OUT && bitbang_flush(buffer) != ERROR_OK)
+			return ERROR_FAIL;
+	}
+
 	size_t buffered = 0;
-	for (bit_cnt = 0; bit_cnt < scan_size; bit_cnt++) {
+	for (bit_cnt = 0; !bitbang_interface->write_vector && bit_cnt < scan_size; bit_cnt++) {
 		int tms = (bit_cnt == scan_size-1) ? 1 : 0;
 		int tdi;
 		int bytec = bit_cnt/8;
@@ -234,7 +317,7 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 		if ((type != SCAN_IN) && (buffer[bytec] & bcval))
 			tdi = 1;
 
-		if (bitbang_interface->write(0, tms, tdi) != ERROR_OK)
+		if (bitbang_write(0, tms, tdi) != ERROR_OK)
 			return ERROR_FAIL;
 
 		if (type != SCAN_OUT) {
@@ -256,7 +339,7 @@ static int bitbang_scan(bool ir_scan, enum scan_type type, uint8_t *buffer,
 			}
 		}
 
-		if (bitbang_interface->write(1, tms, tdi) != ERROR_OK)
+		if (bitbang_write(1, tms, tdi) != ERROR_OK)
 			return ERROR_FAIL;
 
 		if (type != SCAN_OUT && bitbang_interface->buf_size &&
@@ -363,6 +446,8 @@ int bitbang_execute_queue(void)
 				break;
 			case JTAG_SLEEP:
 				LOG_DEBUG_IO("sleep %" PRIi32, cmd->cmd.sleep->us);
+				if (bitbang_flush(NULL) != ERROR_OK)
+					return ERROR_FAIL;
 				jtag_sleep(cmd->cmd.sleep->us);
 				break;
 			case JTAG_TMS:
@@ -374,6 +459,8 @@ int bitbang_execute_queue(void)
 		}
 		cmd = cmd->next;
 	}
+	if (bitbang_flush(NULL) != ERROR_OK)
+		return ERROR_FAIL;
 	if (bitbang_interface->blink) {
 		if (bitbang_interface->blink(0) != ERROR_OK)
 			return ERROR_FAIL;
@@ -398,12 +485,35 @@ static void bitbang_exchange(bool rnw, uint8_t buf[], unsigned int offset, unsig
 	LOG_DEBUG("bitbang_exchange");
 	int tdi;
 
+	if (bitbang_interface->write_vector) {
+		uint8_t in[DIV_ROUND_UP(64, 8)];
+		bool capture = rnw && buf;
+
+		/* SWD exchanges are at most a few dozen bits long */
+		assert(!capture || bit_cnt <= 64);
+
+		for (unsigned int i = offset; i < bit_cnt + offset; i++) {
+			tdi = !rnw && (buf[i/8] & (1 << (i % 8)));
+			if (capture)
+				bitbang_write_sample(0, 0, tdi);
+			else
+				bitbang_write(0, 0, tdi);
+			bitbang_write(1, 0, tdi);
+		}
+
+		if (capture) {
+			bitbang_flush(in);
+			buf_set_buf(in, 0, buf, offset, bit_cnt);
+		}
+		return;
+	}
+
 	for (unsigned int i = offset; i < bit_cnt + offset; i++) {
 		int bytec = i/8;
 		int bcval = 1 << (i % 8);
 		tdi = !rnw && (buf[bytec] & bcval);
 
-		bitbang_interface->write(0, 0, tdi);
+		bitbang_write(0, 0, tdi);
 
 		if (rnw && buf) {
 			if (bitbang_interface->swdio_read())
@@ -412,7 +522,7 @@ static void bitbang_exchange(bool rnw, uint8_t buf[], unsigned int offset, unsig
 				buf[bytec] &= ~bcval;
 		}
 
-		bitbang_interface->write(1, 0, tdi);
+		bitbang_write(1, 0, tdi);
 	}
 }
 
@@ -438,13 +548,14 @@ int bitbang_swd_switch_seq(enum swd_special_seq seq)
 		return ERROR_FAIL;
 	}
 
-	return ERROR_OK;
+	return bitbang_flush(NULL);
 }
 
 void bitbang_switch_to_swd(void)
 {
 	LOG_DEBUG("bitbang_switch_to_swd");
 	bitbang_exchange(false, (uint8_t *)swd_seq_jtag_to_swd, 0, swd_seq_jtag_to_swd_len);
+	bitbang_flush(NULL);
 }
 
 static void swd_clear_sticky_errors(void)
@@ -469,8 +580,10 @@ static void bitbang_swd_read_reg(uint8_t cmd, uint32_t *value, uint32_t ap_delay
 		cmd |= SWD_CMD_START | (1 << 7);
 		bitbang_exchange(false, &cmd, 0, 8);
 
+		bitbang_flush(NULL);
 		bitbang_interface->swdio_drive(false);
 		bitbang_exchange(true, trn_ack_data_parity_trn, 0, 1 + 3 + 32 + 1 + 1);
+		bitbang_flush(NULL);
 		bitbang_interface->swdio_drive(true);
 
 		int ack = buf_get_u32(trn_ack_data_parity_trn, 1, 3);
@@ -530,8 +643,10 @@ static void bitbang_swd_write_reg(uint8_t cmd, uint32_t value, uint32_t ap_delay
 		cmd |= SWD_CMD_START | (1 << 7);
 		bitbang_exchange(false, &cmd, 0, 8);
 
+		bitbang_flush(NULL);
 		bitbang_interface->swdio_drive(false);
 		bitbang_exchange(true, trn_ack_data_parity_trn, 0, 1 + 3 + 1);
+		bitbang_flush(NULL);
 		bitbang_interface->swdio_drive(true);
 		bitbang_exchange(false, trn_ack_data_parity_trn, 1 + 3 + 1, 32 + 1);
 
@@ -570,6 +685,7 @@ static int bitbang_swd_run_queue(void)
 	/* A transaction must be followed by another transaction or at least 8 idle cycles to
 	 * ensure that data is clocked through the AP. */
 	bitbang_exchange(true, NULL, 0, 8);
+	bitbang_flush(NULL);
 
 	int retval = queued_retval;
 	queued_retval = ERROR_OK;
@@ -30,6 +30,13 @@ typedef enum {
 	BB_ERROR
 } bb_value_t;
 
+/* Pin state bits of a write_vector() entry */
+#define BB_VEC_TCK		0x01
+#define BB_VEC_TMS		0x02
+#define BB_VEC_TDI		0x04
+/** Sample TDO (SWDIO in SWD mode) after applying this state */
+#define BB_VEC_SAMPLE	0x08
+
 /** Low level callbacks (for bitbang).
  *
  * Either read(), or sample() and read_sample() must be implemented.
@@ -51,6 +58,13 @@ struct bitbang_interface {
 
 	/** Set TCK, TMS, and TDI to the given values. */
 	int (*write)(int tck, int tms, int tdi);
+
+	/** Optional. Apply @a count pin states in order, each a combination of
+	 * the BB_VEC_* bits. For every state flagged with BB_VEC_SAMPLE, store
+	 * the sampled input in the next bit of @a in, starting at bit 0.
+	 * When present, the core queues all pin changes and hands them over in
+	 * bulk instead of calling write(), read() and swdio_read() per bit. */
+	int (*write_vector)(const uint8_t *states, size_t count, uint8_t *in);
 	int (*blink)(int on);
 	int (*swdio_read)(void);
 	void (*swdio_drive)(bool on);
@@ -72,6 +72,28 @@ static int dummy_write(int tck, int tms, int tdi)
 	return ERROR_OK;
 }
 
+/* Replays the vector through the same TAP model, so per-bit and vector
+ * dispatch can be compared with "dummy vector on|off". */
+static int dummy_write_vector(const uint8_t *states, size_t count, uint8_t *in)
+{
+	unsigned int n = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		dummy_write(!!(states[i] & BB_VEC_TCK), !!(states[i] & BB_VEC_TMS),
+				!!(states[i] & BB_VEC_TDI));
+
+		if (states[i] & BB_VEC_SAMPLE) {
+			if (dummy_read() == BB_HIGH)
+				in[n / 8] |= 1 << (n % 8);
+			else
+				in[n / 8] &= ~(1 << (n % 8));
+			n++;
+		}
+	}
+
+	return ERROR_OK;
+}
+
 static int dummy_reset(int trst, int srst)
 {
 	dummy_clock = 0;
@@ -91,6 +113,7 @@ static int dummy_led(int on)
 static struct bitbang_interface dummy_bitbang = {
 		.read = &dummy_read,
 		.write = &dummy_write,
+		.write_vector = &dummy_write_vector,
 		.blink = &dummy_led,
 	};
 
@@ -130,12 +153,38 @@ static int dummy_quit(void)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(dummy_handle_vector_command)
+{
+	bool enable = dummy_bitbang.write_vector != NULL;
+	int retval = CALL_COMMAND_HANDLER(handle_command_parse_bool, &enable,
+			"bitbang vector interface");
+	if (retval != ERROR_OK)
+		return retval;
+
+	dummy_bitbang.write_vector = enable ? &dummy_write_vector : NULL;
+	return ERROR_OK;
+}
+
+static const struct command_registration dummy_subcommand_handlers[] = {
+	{
+		.name = "vector",
+		.handler = dummy_handle_vector_command,
+		.mode = COMMAND_ANY,
+		.help = "use the bitbang vector interface instead of per bit writes",
+		.usage = "['on'|'off']",
+	},
+	{
+		.chain = hello_command_handlers,
+	},
+	COMMAND_REGISTRATION_DONE
+};
+
 static const struct command_registration dummy_command_handlers[] = {
 	{
 		.name = "dummy",
 		.mode = COMMAND_ANY,
 		.help = "dummy interface driver commands",
-		.chain = hello_command_handlers,
+		.chain = dummy_subcommand_handlers,
 		.usage = "",
 	},
 	COMMAND_REGISTRATION_DONE,
@@ -1990,9 +1990,10 @@ static int stlink_usb_step(void *handle)
 }
 
 /** */
-static int stlink_usb_read_regs(void *handle)
+static int stlink_usb_read_regs(void *handle, uint32_t *regs)
 {
 	int res;
+	unsigned int offset;
 	struct stlink_usb_handle_s *h = handle;
 
 	assert(handle != NULL);
@@ -2005,13 +2006,22 @@ static int stlink_usb_read_regs(void *handle)
 		h->cmdbuf[h->cmdidx++] = STLINK_DEBUG_APIV1_READALLREGS;
 		res = stlink_usb_xfer_noerrcheck(handle, h->databuf, 84);
 		/* regs data from offset 0 */
+		offset = 0;
 	} else {
 		h->cmdbuf[h->cmdidx++] = STLINK_DEBUG_APIV2_READALLREGS;
 		res = stlink_usb_xfer_errcheck(handle, h->databuf, 88);
 		/* status at offset 0, regs data from offset 4 */
+		offset = 4;
 	}
 
-	return res;
+	if (res != ERROR_OK)
+		return res;
+
+	/* R0-R15, xPSR, MSP and PSP come first, in DCRSR selector order */
+	for (unsigned int i = 0; i < HL_NUM_BULK_REGS; i++)
+		regs[i] = le_to_h_u32(h->databuf + offset + 4 * i);
+
+	return ERROR_OK;
 }
 
 /** */
@@ -470,10 +470,10 @@ static int icdi_usb_step(void *handle)
 	return result;
 }
 
-static int icdi_usb_read_regs(void *handle)
+static int icdi_usb_read_regs(void *handle, uint32_t *regs)
 {
 	/* currently unsupported */
-	return ERROR_OK;
+	return ERROR_COMMAND_NOTFOUND;
 }
 
 static int icdi_usb_read_reg(void *handle, int num, uint32_t *val)
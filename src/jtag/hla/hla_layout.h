@@ -32,6 +32,9 @@ struct hl_interface_param_s;
 extern struct hl_layout_api_s stlink_usb_layout_api;
 extern struct hl_layout_api_s icdi_usb_layout_api;
 
+/** Number of core registers returned by hl_layout_api_s::read_regs */
+#define HL_NUM_BULK_REGS 19
+
 /** */
 struct hl_layout_api_s {
 	/** */
@@ -48,8 +51,16 @@ struct hl_layout_api_s {
 	int (*halt) (void *handle);
 	/** */
 	int (*step) (void *handle);
-	/** */
-	int (*read_regs) (void *handle);
+	/**
+	 * Read the core registers R0-R15, xPSR, MSP and PSP (DCRSR
+	 * selectors 0 to HL_NUM_BULK_REGS - 1) in one adapter transaction
+	 *
+	 * @param handle A pointer to the device-specific handle
+	 * @param regs Storage for HL_NUM_BULK_REGS register values
+	 * @returns ERROR_OK on success, ERROR_COMMAND_NOTFOUND if the adapter
+	 * cannot read registers in bulk, or an error code on failure.
+	 */
+	int (*read_regs) (void *handle, uint32_t *regs);
 	/** */
 	int (*read_reg) (void *handle, int num, uint32_t *val);
 	/** */
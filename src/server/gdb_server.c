@@ -97,6 +97,9 @@ struct gdb_connection {
 	struct target_desc_format target_desc;
 	/* temporarily used for thread list support */
 	char *thread_list;
+	/* register packet buffer, kept across 'g' and 'p' packets */
+	char *reg_packet;
+	size_t reg_packet_size;
 };
 
 #if 0
@@ -955,6 +958,8 @@ static int gdb_new_connection(struct connection *connection)
 	gdb_connection->target_desc.tdesc = NULL;
 	gdb_connection->target_desc.tdesc_length = 0;
 	gdb_connection->thread_list = NULL;
+	gdb_connection->reg_packet = NULL;
+	gdb_connection->reg_packet_size = 0;
 
 	/* send ACK to GDB for debug request */
 	gdb_write(connection, "+", 1);
@@ -1041,6 +1046,8 @@ static int gdb_connection_closed(struct connection *connection)
 	 */
 	log_remove_callback(gdb_log_callback, connection);
 
+	breakpoint_batch_end(target);
+
 	gdb_actual_connections--;
 	LOG_DEBUG("GDB Close, Target: %s, state: %s, gdb_actual_connections=%d",
 		target_name(target),
@@ -1057,6 +1064,9 @@ static int gdb_connection_closed(struct connection *connection)
 	/* if this connection registered a debug-message receiver delete it */
 	delete_debug_msg_receiver(connection->cmd_ctx, target);
 
+	free(gdb_connection->reg_packet);
+	gdb_connection->reg_packet = NULL;
+
 	if (connection->priv) {
 		free(connection->priv);
 		connection->priv = NULL;
@@ -1157,6 +1167,22 @@ static void gdb_target_to_reg(struct target *target,
 	}
 }
 
+/* Return a buffer of at least size bytes for a register reply packet */
+static char *gdb_get_reg_packet_buffer(struct connection *connection, size_t size)
+{
+	struct gdb_connection *gdb_con = connection->priv;
+
+	if (gdb_con->reg_packet_size < size) {
+		char *buf = realloc(gdb_con->reg_packet, size);
+		if (buf == NULL)
+			return NULL;
+		gdb_con->reg_packet = buf;
+		gdb_con->reg_packet_size = size;
+	}
+
+	return gdb_con->reg_packet;
+}
+
 static int gdb_get_registers_packet(struct connection *connection,
 		char const *packet, int packet_size)
 {
@@ -1168,6 +1194,7 @@ static int gdb_get_registers_packet(struct connection *connection,
 	char *reg_packet;
 	char *reg_packet_p;
 	int i;
+	int invalid = 0;
 
 #ifdef _DEBUG_GDB_IO_
 	LOG_DEBUG("-");
@@ -1185,13 +1212,25 @@ static int gdb_get_registers_packet(struct connection *connection,
 		if (reg_list[i] == NULL || reg_list[i]->exist == false)
 			continue;
 		reg_packet_size += DIV_ROUND_UP(reg_list[i]->size, 8) * 2;
+		if (!reg_list[i]->valid)
+			invalid++;
 	}
 
 	assert(reg_packet_size > 0);
 
-	reg_packet = malloc(reg_packet_size + 1); /* plus one for string termination null */
-	if (reg_packet == NULL)
+	/* plus one for string termination null */
+	reg_packet = gdb_get_reg_packet_buffer(connection, reg_packet_size + 1);
+	if (reg_packet == NULL) {
+		free(reg_list);
 		return ERROR_FAIL;
+	}
+
+	/* let the target fetch what it can in one go; the rest is read below */
+	if (invalid > 1) {
+		retval = target_get_registers_bulk(target, reg_list, reg_list_size);
+		if (retval != ERROR_OK)
+			LOG_DEBUG("bulk register read failed (%d)", retval);
+	}
 
 	reg_packet_p = reg_packet;
 
@@ -1202,7 +1241,6 @@ static int gdb_get_registers_packet(struct connection *connection,
 			retval = reg_list[i]->type->get(reg_list[i]);
 			if (retval != ERROR_OK && gdb_report_register_access_error) {
 				LOG_DEBUG("Couldn't get register %s.", reg_list[i]->name);
-				free(reg_packet);
 				free(reg_list);
 				return gdb_error(connection, retval);
 			}
@@ -1221,7 +1259,6 @@ static int gdb_get_registers_packet(struct connection *connection,
 #endif
 
 	gdb_put_packet(connection, reg_packet, reg_packet_size);
-	free(reg_packet);
 
 	free(reg_list);
 
@@ -1325,14 +1362,19 @@ static int gdb_get_register_packet(struct connection *connection,
 		}
 	}
 
-	reg_packet = malloc(DIV_ROUND_UP(reg_list[reg_num]->size, 8) * 2 + 1); /* plus one for string termination null */
+	/* plus one for string termination null */
+	reg_packet = gdb_get_reg_packet_buffer(connection,
+			DIV_ROUND_UP(reg_list[reg_num]->size, 8) * 2 + 1);
+	if (reg_packet == NULL) {
+		free(reg_list);
+		return ERROR_FAIL;
+	}
 
 	gdb_str_to_target(target, reg_packet, reg_list[reg_num]);
 
 	gdb_put_packet(connection, reg_packet, DIV_ROUND_UP(reg_list[reg_num]->size, 8) * 2);
 
 	free(reg_list);
-	free(reg_packet);
 
 	return ERROR_OK;
 }
@@ -1691,6 +1733,10 @@ static int gdb_breakpoint_watchpoint_packet(struct connection *connection,
 	switch (type) {
 		case 0:
 		case 1:
+			/* gdb (re)inserts or removes all its breakpoints in a row,
+			 * apply them at once when the next other packet arrives */
+			if (bp_type == BKPT_SOFT)
+				breakpoint_batch_begin(target);
 			if (packet[0] == 'Z') {
 				retval = breakpoint_add(target, address, size, bp_type);
 				if (retval != ERROR_OK) {
@@ -3267,6 +3313,18 @@ static int gdb_input_inner(struct connection *connection)
 				LOG_DEBUG("received packet: '%s'", packet);
 		}
 
+		/* Breakpoint changes deferred by Z/z packets must be in place before
+		 * any other packet is handled. A failure is the answer to that packet,
+		 * leaving out the ones that end the session. */
+		if (packet_size > 0 && packet[0] != 'Z' && packet[0] != 'z') {
+			retval = breakpoint_batch_end(target);
+			if (retval != ERROR_OK && packet[0] != 'k' && packet[0] != 'D') {
+				LOG_ERROR("Failed to apply breakpoint changes");
+				gdb_error(connection, retval);
+				packet_size = 0;
+			}
+		}
+
 		if (packet_size > 0) {
 			retval = ERROR_OK;
 			switch (packet[0]) {
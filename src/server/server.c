@@ -27,6 +27,7 @@
 #endif
 
 #include "server.h"
+#include <helper/time_support.h>
 #include <target/target.h>
 #include <target/target_request.h>
 #include <target/openrisc/jsp_server.h>
@@ -481,8 +482,15 @@ int server_loop(struct command_context *command_context)
 			tv.tv_usec = 0;
 			retval = socket_select(fd_max + 1, &read_fds, NULL, NULL, &tv);
 		} else {
-			/* Every 100ms, can be changed with "poll_period" command */
-			tv.tv_usec = polling_period * 1000;
+			/* Every 100ms, can be changed with "poll_period" command,
+			 * earlier when a running target is due to be polled */
+			int64_t timeout_ms = target_poll_next_event() - timeval_ms();
+			if (timeout_ms > polling_period)
+				timeout_ms = polling_period;
+			else if (timeout_ms < 0)
+				timeout_ms = 0;
+			tv.tv_sec = timeout_ms / 1000;
+			tv.tv_usec = (timeout_ms % 1000) * 1000;
 			/* Only while we're sleeping we'll let others run */
 			openocd_sleep_prelude();
 			kept_alive();
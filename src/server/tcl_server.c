@@ -28,6 +28,19 @@
 #define TCL_LINE_INITIAL		(4*1024)
 #define TCL_LINE_MAX			(4*1024*1024)
 
+/* Binary framing, see "Tcl RPC server binary mode" in the manual.
+ * Every frame starts with three little endian 32 bit words: payload
+ * length, tag and opcode (requests) or status (responses). */
+#define TCL_BIN_HDR_SIZE		12
+#define TCL_BIN_PAYLOAD_MAX		(TCL_LINE_MAX - TCL_BIN_HDR_SIZE - 1)
+#define TCL_BIN_TAG_NOTIFY		0xffffffff
+
+enum tcl_bin_op {
+	TCL_BIN_OP_EVAL = 0,
+	TCL_BIN_OP_READ = 1,
+	TCL_BIN_OP_WRITE = 2,
+};
+
 struct tcl_connection {
 	int tc_linedrop;
 	int tc_lineoffset;
@@ -37,6 +50,7 @@ struct tcl_connection {
 	enum target_state tc_laststate;
 	bool tc_notify;
 	bool tc_trace;
+	bool tc_binary;
 };
 
 static char *tcl_port;
@@ -46,6 +60,20 @@ static int tcl_new_connection(struct connection *connection);
 static int tcl_input(struct connection *connection);
 static int tcl_output(struct connection *connection, const void *buf, ssize_t len);
 static int tcl_closed(struct connection *connection);
+static int tcl_output_frame(struct connection *connection, uint32_t tag,
+		int status, const void *payload, uint32_t len);
+
+/* send an asynchronous notification, msg is terminated by "\r\n\x1a" */
+static int tcl_output_notification(struct connection *connection, const char *msg)
+{
+	struct tcl_connection *tclc = connection->priv;
+
+	if (tclc->tc_binary)
+		return tcl_output_frame(connection, TCL_BIN_TAG_NOTIFY, ERROR_OK,
+				msg, strlen(msg) - 3);
+
+	return tcl_output(connection, msg, strlen(msg));
+}
 
 static int tcl_target_callback_event_handler(struct target *target,
 		enum target_event event, void *priv)
@@ -58,14 +86,14 @@ static int tcl_target_callback_event_handler(struct target *target,
 
 	if (tclc->tc_notify) {
 		snprintf(buf, sizeof(buf), "type target_event event %s\r\n\x1a", target_event_name(event));
-		tcl_output(connection, buf, strlen(buf));
+		tcl_output_notification(connection, buf);
 	}
 
 	if (tclc->tc_laststate != target->state) {
 		tclc->tc_laststate = target->state;
 		if (tclc->tc_notify) {
 			snprintf(buf, sizeof(buf), "type target_state state %s\r\n\x1a", target_state_name(target));
-			tcl_output(connection, buf, strlen(buf));
+			tcl_output_notification(connection, buf);
 		}
 	}
 
@@ -83,7 +111,7 @@ static int tcl_target_callback_reset_handler(struct target *target,
 
 	if (tclc->tc_notify) {
 		snprintf(buf, sizeof(buf), "type target_reset mode %s\r\n\x1a", target_reset_mode_name(reset_mode));
-		tcl_output(connection, buf, strlen(buf));
+		tcl_output_notification(connection, buf);
 	}
 
 	return ERROR_OK;
@@ -107,7 +135,7 @@ static int tcl_target_callback_trace_handler(struct target *target,
 		buf = malloc(max_len);
 		hexify(hex, data, len, hex_len);
 		snprintf(buf, max_len, "%s%s%s", header, hex, trailer);
-		tcl_output(connection, buf, strlen(buf));
+		tcl_output_notification(connection, buf);
 		free(hex);
 		free(buf);
 	}
@@ -139,6 +167,28 @@ int tcl_output(struct connection *connection, const void *data, ssize_t len)
 	return ERROR_SERVER_REMOTE_CLOSED;
 }
 
+/* write one binary mode frame, header and payload in a single write */
+static int tcl_output_frame(struct connection *connection, uint32_t tag,
+		int status, const void *payload, uint32_t len)
+{
+	uint8_t *frame;
+	int retval;
+
+	frame = malloc(TCL_BIN_HDR_SIZE + len);
+	if (frame == NULL)
+		return ERROR_FAIL;
+
+	h_u32_to_le(frame, len);
+	h_u32_to_le(frame + 4, tag);
+	h_u32_to_le(frame + 8, status);
+	if (len)
+		memcpy(frame + TCL_BIN_HDR_SIZE, payload, len);
+
+	retval = tcl_output(connection, frame, TCL_BIN_HDR_SIZE + len);
+	free(frame);
+	return retval;
+}
+
 /* connections */
 static int tcl_new_connection(struct connection *connection)
 {
@@ -171,32 +221,159 @@ static int tcl_new_connection(struct connection *connection)
 	return ERROR_OK;
 }
 
-static int tcl_input(struct connection *connection)
+/* make room for at least size bytes in the line buffer */
+static int tcl_line_reserve(struct tcl_connection *tclc, int size)
+{
+	char *tc_line_new;
+
+	if (size <= tclc->tc_line_size)
+		return ERROR_OK;
+
+	tc_line_new = realloc(tclc->tc_line, size);
+	if (tc_line_new == NULL)
+		return ERROR_FAIL;
+
+	tclc->tc_line = tc_line_new;
+	tclc->tc_line_size = size;
+	return ERROR_OK;
+}
+
+/* Execute one complete binary frame sitting in tc_line. Memory reads
+ * go straight from target_read_buffer() into the response frame. */
+static int tcl_binary_request(struct connection *connection)
 {
 	Jim_Interp *interp = (Jim_Interp *)connection->cmd_ctx->interp;
-	int retval;
-	int i;
-	ssize_t rlen;
+	struct tcl_connection *tclc = connection->priv;
+	uint8_t *hdr = (uint8_t *)tclc->tc_line;
+	uint8_t *payload = hdr + TCL_BIN_HDR_SIZE;
+	uint32_t len = le_to_h_u32(hdr);
+	uint32_t tag = le_to_h_u32(hdr + 4);
+	uint32_t op = le_to_h_u32(hdr + 8);
+	struct target *target;
+	target_addr_t address;
+	uint32_t count;
+	uint8_t *frame;
 	const char *result;
 	int reslen;
-	struct tcl_connection *tclc;
-	unsigned char in[256];
-	char *tc_line_new;
-	int tc_line_size_new;
+	int retval;
 
-	rlen = connection_read(connection, &in, sizeof(in));
-	if (rlen <= 0) {
-		if (rlen < 0)
-			LOG_ERROR("error during read: %s", strerror(errno));
-		return ERROR_SERVER_REMOTE_CLOSED;
+	switch (op) {
+	case TCL_BIN_OP_EVAL:
+		payload[len] = '\0';
+		retval = command_run_line(connection->cmd_ctx, (char *)payload);
+		result = Jim_GetString(Jim_GetResult(interp), &reslen);
+		return tcl_output_frame(connection, tag, retval, result, reslen);
+
+	case TCL_BIN_OP_READ:
+	case TCL_BIN_OP_WRITE:
+		/* 64 bit address, then a 32 bit count (read) or the data (write) */
+		if (len < 8 || (op == TCL_BIN_OP_READ && len != 12))
+			return tcl_output_frame(connection, tag,
+					ERROR_COMMAND_SYNTAX_ERROR, NULL, 0);
+
+		target = get_current_target_or_null(connection->cmd_ctx);
+		if (target == NULL)
+			return tcl_output_frame(connection, tag, ERROR_FAIL, NULL, 0);
+
+		address = le_to_h_u64(payload);
+		if (op == TCL_BIN_OP_WRITE) {
+			retval = target_write_buffer(target, address, len - 8, payload + 8);
+			return tcl_output_frame(connection, tag, retval, NULL, 0);
+		}
+
+		count = le_to_h_u32(payload + 8);
+		if (count > TCL_BIN_PAYLOAD_MAX)
+			return tcl_output_frame(connection, tag,
+					ERROR_COMMAND_ARGUMENT_INVALID, NULL, 0);
+
+		frame = malloc(TCL_BIN_HDR_SIZE + count);
+		if (frame == NULL)
+			return tcl_output_frame(connection, tag, ERROR_FAIL, NULL, 0);
+
+		retval = target_read_buffer(target, address, count,
+				frame + TCL_BIN_HDR_SIZE);
+		if (retval != ERROR_OK) {
+			free(frame);
+			return tcl_output_frame(connection, tag, retval, NULL, 0);
+		}
+
+		h_u32_to_le(frame, count);
+		h_u32_to_le(frame + 4, tag);
+		h_u32_to_le(frame + 8, ERROR_OK);
+		retval = tcl_output(connection, frame, TCL_BIN_HDR_SIZE + count);
+		free(frame);
+		return retval;
+
+	default:
+		LOG_DEBUG("tcl: unknown binary opcode %" PRIu32, op);
+		return tcl_output_frame(connection, tag, ERROR_COMMAND_NOTFOUND, NULL, 0);
 	}
+}
 
-	tclc = connection->priv;
-	if (tclc == NULL)
-		return ERROR_CONNECTION_REJECTED;
+/* Consume binary mode input, stopping after each executed frame so that a
+ * frame switching back to text mode takes effect for the bytes after it.
+ * Clients may send any number of frames without waiting for responses;
+ * they are executed in order and answered with the request tag. */
+static int tcl_binary_input(struct connection *connection,
+		const unsigned char *in, ssize_t len, ssize_t *used)
+{
+	struct tcl_connection *tclc = connection->priv;
+	ssize_t i = 0;
+	ssize_t n;
+	uint32_t plen;
+	int need;
+
+	while (i < len) {
+		if (tclc->tc_lineoffset < TCL_BIN_HDR_SIZE) {
+			n = MIN(TCL_BIN_HDR_SIZE - tclc->tc_lineoffset, len - i);
+			memcpy(tclc->tc_line + tclc->tc_lineoffset, in + i, n);
+			tclc->tc_lineoffset += n;
+			i += n;
+			if (tclc->tc_lineoffset < TCL_BIN_HDR_SIZE)
+				break;
+		}
+
+		plen = le_to_h_u32((uint8_t *)tclc->tc_line);
+		if (plen > TCL_BIN_PAYLOAD_MAX) {
+			LOG_ERROR("tcl: binary frame of %" PRIu32 " bytes too large", plen);
+			return ERROR_SERVER_REMOTE_CLOSED;
+		}
+		need = TCL_BIN_HDR_SIZE + plen;
+		/* one spare byte to terminate EVAL scripts */
+		if (tcl_line_reserve(tclc, need + 1) != ERROR_OK)
+			return ERROR_SERVER_REMOTE_CLOSED;
+
+		n = MIN(need - tclc->tc_lineoffset, len - i);
+		memcpy(tclc->tc_line + tclc->tc_lineoffset, in + i, n);
+		tclc->tc_lineoffset += n;
+		i += n;
+
+		if (tclc->tc_lineoffset == need) {
+			tclc->tc_lineoffset = 0;
+			*used = i;
+			return tcl_binary_request(connection);
+		}
+	}
+
+	*used = i;
+	return ERROR_OK;
+}
+
+/* Consume text mode input up to and including the first 0x1a */
+static int tcl_text_input(struct connection *connection,
+		const unsigned char *in, ssize_t len, ssize_t *used)
+{
+	Jim_Interp *interp = (Jim_Interp *)connection->cmd_ctx->interp;
+	int retval;
+	ssize_t i;
+	const char *result;
+	int reslen;
+	struct tcl_connection *tclc = connection->priv;
+	char *tc_line_new;
+	int tc_line_size_new;
 
 	/* push as much data into the line as possible */
-	for (i = 0; i < rlen; i++) {
+	for (i = 0; i < len; i++) {
 		/* buffer the data */
 		tclc->tc_line[tclc->tc_lineoffset] = in[i];
 		if (tclc->tc_lineoffset + 1 < tclc->tc_line_size) {
@@ -232,6 +409,8 @@ static int tcl_input(struct connection *connection)
 		if (in[i] != '\x1a')
 			continue;
 
+		*used = i + 1;
+
 		/* process the line */
 		if (tclc->tc_linedrop) {
 #define ESTR "line too long\n"
@@ -252,6 +431,44 @@ static int tcl_input(struct connection *connection)
 
 		tclc->tc_lineoffset = 0;
 		tclc->tc_linedrop = 0;
+		return ERROR_OK;
+	}
+
+	*used = len;
+	return ERROR_OK;
+}
+
+static int tcl_input(struct connection *connection)
+{
+	int retval;
+	ssize_t rlen;
+	ssize_t used;
+	struct tcl_connection *tclc;
+	unsigned char in[4096];
+	unsigned char *p = in;
+
+	rlen = connection_read(connection, &in, sizeof(in));
+	if (rlen <= 0) {
+		if (rlen < 0)
+			LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	tclc = connection->priv;
+	if (tclc == NULL)
+		return ERROR_CONNECTION_REJECTED;
+
+	/* the framing can change after any command, so hand over one
+	 * command at a time */
+	while (rlen > 0) {
+		if (tclc->tc_binary)
+			retval = tcl_binary_input(connection, p, rlen, &used);
+		else
+			retval = tcl_text_input(connection, p, rlen, &used);
+		if (retval != ERROR_OK)
+			return retval;
+		p += used;
+		rlen -= used;
 	}
 
 	return ERROR_OK;
@@ -327,6 +544,23 @@ COMMAND_HANDLER(handle_tcl_trace_command)
 	}
 }
 
+COMMAND_HANDLER(handle_tcl_binary_command)
+{
+	struct connection *connection = NULL;
+	struct tcl_connection *tclc = NULL;
+
+	if (CMD_CTX->output_handler_priv != NULL)
+		connection = CMD_CTX->output_handler_priv;
+
+	if (connection != NULL && !strcmp(connection->service->name, "tcl")) {
+		tclc = connection->priv;
+		return CALL_COMMAND_HANDLER(handle_command_parse_bool, &tclc->tc_binary, "Binary framing ");
+	} else {
+		LOG_ERROR("%s: can only be called from the tcl server", CMD_NAME);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+}
+
 static const struct command_registration tcl_command_handlers[] = {
 	{
 		.name = "tcl_port",
@@ -351,6 +585,14 @@ static const struct command_registration tcl_command_handlers[] = {
 		.help = "Target trace output",
 		.usage = "[on|off]",
 	},
+	{
+		.name = "tcl_binary",
+		.handler = handle_tcl_binary_command,
+		.mode = COMMAND_EXEC,
+		.help = "Switch the current connection to length prefixed "
+			"binary frames",
+		.usage = "[on|off]",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
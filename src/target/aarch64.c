@@ -292,6 +292,83 @@ static int aarch64_check_state_one(struct target *target,
 	return ERROR_OK;
 }
 
+static unsigned int aarch64_smp_count(struct target *target)
+{
+	struct target_list *head;
+	unsigned int count = 0;
+
+	foreach_smp_target(head, target->head)
+		count++;
+
+	return count;
+}
+
+/*
+ * Flush the queues of all DAPs serving the PEs of an SMP group, each DAP
+ * once even if it is shared by several PEs.
+ */
+static int aarch64_run_smp(struct target *target)
+{
+	struct target_list *head, *prev;
+	int retval;
+
+	foreach_smp_target(head, target->head) {
+		struct target *curr = head->target;
+		struct adiv5_dap *dap;
+		bool flushed = false;
+
+		if (!target_was_examined(curr))
+			continue;
+
+		dap = target_to_armv8(curr)->debug_ap->dap;
+		foreach_smp_target(prev, target->head) {
+			if (prev == head)
+				break;
+			if (target_was_examined(prev->target) &&
+					target_to_armv8(prev->target)->debug_ap->dap == dap) {
+				flushed = true;
+				break;
+			}
+		}
+		if (flushed)
+			continue;
+
+		retval = dap_run(dap);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	return ERROR_OK;
+}
+
+/*
+ * Sample PRSR of all examined PEs of the SMP group in one queued transaction
+ * per DAP. prsr[] is indexed by the position of the PE in the group and
+ * must hold aarch64_smp_count() entries; unexamined PEs read as zero.
+ */
+static int aarch64_read_prsr_smp(struct target *target, uint32_t *prsr)
+{
+	struct target_list *head;
+	unsigned int i = 0;
+	int retval;
+
+	foreach_smp_target(head, target->head) {
+		struct target *curr = head->target;
+		struct armv8_common *armv8 = target_to_armv8(curr);
+
+		prsr[i] = 0;
+		if (target_was_examined(curr)) {
+			retval = mem_ap_read_u32(armv8->debug_ap,
+					armv8->debug_base + CPUV8_DBG_PRSR, &prsr[i]);
+			if (retval != ERROR_OK)
+				return retval;
+		}
+		i++;
+	}
+
+	return aarch64_run_smp(target);
+}
+
 static int aarch64_wait_halt_one(struct target *target)
 {
 	int retval = ERROR_OK;
@@ -407,29 +484,44 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 	if (retval != ERROR_OK)
 		return retval;
 
-	/* wait for all PEs to halt */
+	unsigned int count = aarch64_smp_count(target);
+	uint32_t *prsr = calloc(count, sizeof(*prsr));
+	int64_t *halted_at = calloc(count, sizeof(*halted_at));
+	if (prsr == NULL || halted_at == NULL) {
+		LOG_ERROR("Out of memory");
+		free(prsr);
+		free(halted_at);
+		return ERROR_FAIL;
+	}
+	for (unsigned int i = 0; i < count; i++)
+		halted_at[i] = -1;
+
+	/* wait for all PEs to halt, polling the whole group at once */
+	unsigned int polls = 0;
 	int64_t then = timeval_ms();
 	for (;;) {
-		bool all_halted = true;
 		struct target_list *head;
-		struct target *curr;
-
-		foreach_smp_target(head, target->head) {
-			int halted;
-
-			curr = head->target;
+		struct target *curr = NULL;
+		unsigned int i = 0;
 
-			if (!target_was_examined(curr))
-				continue;
+		retval = aarch64_read_prsr_smp(target, prsr);
+		if (retval != ERROR_OK)
+			break;
+		polls++;
 
-			retval = aarch64_check_state_one(curr, PRSR_HALT, PRSR_HALT, &halted, NULL);
-			if (retval != ERROR_OK || !halted) {
-				all_halted = false;
-				break;
+		foreach_smp_target(head, target->head) {
+			if (target_was_examined(head->target)) {
+				if (!(prsr[i] & PRSR_HALT)) {
+					if (curr == NULL)
+						curr = head->target;
+				} else if (halted_at[i] < 0) {
+					halted_at[i] = timeval_ms() - then;
+				}
 			}
+			i++;
 		}
 
-		if (all_halted)
+		if (curr == NULL)
 			break;
 
 		if (timeval_ms() > then + 1000) {
@@ -449,6 +541,28 @@ static int aarch64_halt_smp(struct target *target, bool exc_target)
 			break;
 	}
 
+	if (retval == ERROR_OK) {
+		struct target_list *head;
+		int64_t first = -1, last = -1;
+		unsigned int i = 0;
+
+		foreach_smp_target(head, target->head) {
+			if (halted_at[i] >= 0) {
+				LOG_DEBUG("%s halted after %" PRId64 " ms",
+						target_name(head->target), halted_at[i]);
+				if (first < 0 || halted_at[i] < first)
+					first = halted_at[i];
+				if (halted_at[i] > last)
+					last = halted_at[i];
+			}
+			i++;
+		}
+		LOG_DEBUG("SMP halt skew %" PRId64 " ms, %u status polls",
+				last - first, polls);
+	}
+
+	free(prsr);
+	free(halted_at);
 	return retval;
 }
 
@@ -759,65 +873,70 @@ static int aarch64_prep_restart_smp(struct target *target, int handle_breakpoint
 	return retval;
 }
 
-
-static int aarch64_step_restart_smp(struct target *target)
+/*
+ * Wait for all PEs of the SMP group but 'target' to leave debug state,
+ * polling the whole group at once.
+ */
+static int aarch64_wait_restart_smp(struct target *target)
 {
-	int retval = ERROR_OK;
-	struct target_list *head;
-	struct target *first = NULL;
-
-	LOG_DEBUG("%s", target_name(target));
-
-	retval = aarch64_prep_restart_smp(target, 0, &first);
-	if (retval != ERROR_OK)
-		return retval;
+	unsigned int count = aarch64_smp_count(target);
+	uint32_t *prsr = calloc(count, sizeof(*prsr));
+	bool *resumed = calloc(count, sizeof(*resumed));
+	int retval;
 
-	if (first != NULL)
-		retval = aarch64_do_restart_one(first, RESTART_LAZY);
-	if (retval != ERROR_OK) {
-		LOG_DEBUG("error restarting target %s", target_name(first));
-		return retval;
+	if (prsr == NULL || resumed == NULL) {
+		LOG_ERROR("Out of memory");
+		free(prsr);
+		free(resumed);
+		return ERROR_FAIL;
 	}
 
 	int64_t then = timeval_ms();
 	for (;;) {
-		struct target *curr = target;
-		bool all_resumed = true;
+		struct target_list *head;
+		struct target *curr = NULL;
+		unsigned int i = 0;
 
-		foreach_smp_target(head, target->head) {
-			uint32_t prsr;
-			int resumed;
+		retval = aarch64_read_prsr_smp(target, prsr);
+		if (retval != ERROR_OK)
+			break;
 
-			curr = head->target;
+		foreach_smp_target(head, target->head) {
+			struct target *pe = head->target;
+			uint32_t status = prsr[i];
+			bool *seen = &resumed[i++];
 
-			if (curr == target)
+			if (pe == target || !target_was_examined(pe))
 				continue;
 
-			if (!target_was_examined(curr))
+			/* reading PRSR clears SDR, don't look at PEs seen resumed already */
+			if (*seen)
 				continue;
 
-			retval = aarch64_check_state_one(curr,
-					PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-			if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
-				all_resumed = false;
-				break;
+			if (!(status & PRSR_SDR) && (status & PRSR_HALT)) {
+				if (curr == NULL)
+					curr = pe;
+				continue;
 			}
 
-			if (curr->state != TARGET_RUNNING) {
-				curr->state = TARGET_RUNNING;
-				curr->debug_reason = DBG_REASON_NOTHALTED;
-				target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
+			*seen = true;
+			/* a lazy restart already marks the PE running */
+			if (pe->state != TARGET_RUNNING) {
+				pe->state = TARGET_RUNNING;
+				pe->debug_reason = DBG_REASON_NOTHALTED;
+				target_call_event_callbacks(pe, TARGET_EVENT_RESUMED);
 			}
 		}
 
-		if (all_resumed)
+		if (curr == NULL)
 			break;
 
 		if (timeval_ms() > then + 1000) {
-			LOG_ERROR("%s: timeout waiting for target resume", __func__);
+			LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(curr));
 			retval = ERROR_TARGET_TIMEOUT;
 			break;
 		}
+
 		/*
 		 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
 		 * and it looks like the CTI's are not connected by a common
@@ -828,11 +947,34 @@ static int aarch64_step_restart_smp(struct target *target)
 		retval = aarch64_do_restart_one(curr, RESTART_LAZY);
 		if (retval != ERROR_OK)
 			break;
-}
+	}
 
+	free(prsr);
+	free(resumed);
 	return retval;
 }
 
+static int aarch64_step_restart_smp(struct target *target)
+{
+	int retval = ERROR_OK;
+	struct target *first = NULL;
+
+	LOG_DEBUG("%s", target_name(target));
+
+	retval = aarch64_prep_restart_smp(target, 0, &first);
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (first != NULL)
+		retval = aarch64_do_restart_one(first, RESTART_LAZY);
+	if (retval != ERROR_OK) {
+		LOG_DEBUG("error restarting target %s", target_name(first));
+		return retval;
+	}
+
+	return aarch64_wait_restart_smp(target);
+}
+
 static int aarch64_resume(struct target *target, int current,
 	target_addr_t address, int handle_breakpoints, int debug_execution)
 {
@@ -865,58 +1007,8 @@ static int aarch64_resume(struct target *target, int current,
 	if (retval != ERROR_OK)
 		return retval;
 
-	if (target->smp) {
-		int64_t then = timeval_ms();
-		for (;;) {
-			struct target *curr = target;
-			struct target_list *head;
-			bool all_resumed = true;
-
-			foreach_smp_target(head, target->head) {
-				uint32_t prsr;
-				int resumed;
-
-				curr = head->target;
-				if (curr == target)
-					continue;
-				if (!target_was_examined(curr))
-					continue;
-
-				retval = aarch64_check_state_one(curr,
-						PRSR_SDR, PRSR_SDR, &resumed, &prsr);
-				if (retval != ERROR_OK || (!resumed && (prsr & PRSR_HALT))) {
-					all_resumed = false;
-					break;
-				}
-
-				if (curr->state != TARGET_RUNNING) {
-					curr->state = TARGET_RUNNING;
-					curr->debug_reason = DBG_REASON_NOTHALTED;
-					target_call_event_callbacks(curr, TARGET_EVENT_RESUMED);
-				}
-			}
-
-			if (all_resumed)
-				break;
-
-			if (timeval_ms() > then + 1000) {
-				LOG_ERROR("%s: timeout waiting for target %s to resume", __func__, target_name(curr));
-				retval = ERROR_TARGET_TIMEOUT;
-				break;
-			}
-
-			/*
-			 * HACK: on Hi6220 there are 8 cores organized in 2 clusters
-			 * and it looks like the CTI's are not connected by a common
-			 * trigger matrix. It seems that we need to halt one core in each
-			 * cluster explicitly. So if we find that a core has not halted
-			 * yet, we trigger an explicit resume for the second cluster.
-			 */
-			retval = aarch64_do_restart_one(curr, RESTART_LAZY);
-			if (retval != ERROR_OK)
-				break;
-		}
-	}
+	if (target->smp)
+		retval = aarch64_wait_restart_smp(target);
 
 	if (retval != ERROR_OK)
 		return retval;
@@ -1223,6 +1223,7 @@ static int arc_init_target(struct command_context *cmd_ctx, struct target *targe
 
 static void arc_free_reg_cache(struct reg_cache *cache)
 {
+	register_cache_index_free(cache);
 	free(cache->reg_list);
 	free(cache);
 }
@@ -181,6 +181,31 @@ static void mem_ap_update_tar_cache(struct adiv5_ap *ap)
 		ap->tar_value += inc;
 }
 
+/* Check whether TAR is known to point into the 16-byte block holding address,
+ * so that a banked data register (MEM_AP_REG_BDx) reaches it without a TAR write.
+ */
+static bool mem_ap_tar_in_block(struct adiv5_ap *ap, uint32_t address)
+{
+	return ap->tar_valid && (ap->tar_value & 0xFFFFFFF0) == (address & 0xFFFFFFF0);
+}
+
+/**
+ * Queue transactions preparing a 32-bit access to address through the
+ * banked data registers. The banked registers ignore TAR[3:0], so a TAR
+ * left inside the block by a previous autoincrementing transfer is kept.
+ */
+static int mem_ap_setup_transfer_banked(struct adiv5_ap *ap, uint32_t address)
+{
+	int retval = mem_ap_setup_csw(ap, CSW_32BIT | (ap->csw_value & CSW_ADDRINC_MASK));
+	if (retval != ERROR_OK)
+		return retval;
+
+	if (mem_ap_tar_in_block(ap, address))
+		return ERROR_OK;
+
+	return mem_ap_setup_tar(ap, address & 0xFFFFFFF0);
+}
+
 /**
  * Queue transactions setting up transfer parameters for the
  * currently selected MEM-AP.
@@ -229,9 +254,7 @@ int mem_ap_read_u32(struct adiv5_ap *ap, uint32_t address,
 	/* Use banked addressing (REG_BDx) to avoid some link traffic
 	 * (updating TAR) when reading several consecutive addresses.
 	 */
-	retval = mem_ap_setup_transfer(ap,
-			CSW_32BIT | (ap->csw_value & CSW_ADDRINC_MASK),
-			address & 0xFFFFFFF0);
+	retval = mem_ap_setup_transfer_banked(ap, address);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -281,9 +304,7 @@ int mem_ap_write_u32(struct adiv5_ap *ap, uint32_t address,
 	/* Use banked addressing (REG_BDx) to avoid some link traffic
 	 * (updating TAR) when writing several consecutive addresses.
 	 */
-	retval = mem_ap_setup_transfer(ap,
-			CSW_32BIT | (ap->csw_value & CSW_ADDRINC_MASK),
-			address & 0xFFFFFFF0);
+	retval = mem_ap_setup_transfer_banked(ap, address);
 	if (retval != ERROR_OK)
 		return retval;
 
@@ -364,6 +385,16 @@ static int mem_ap_write(struct adiv5_ap *ap, const uint8_t *buffer, uint32_t siz
 	if (ap->unaligned_access_bad && (address % size != 0))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
+	/* A lone word next to the previous access (e.g. neighbouring debug
+	 * registers) goes through the banked registers, keeping TAR as is. */
+	if (size == 4 && count == 1 && addrinc && !dap->ti_be_32_quirks
+			&& (address & 3) == 0 && mem_ap_tar_in_block(ap, address)) {
+		retval = mem_ap_write_atomic_u32(ap, address, le_to_h_u32(buffer));
+		if (retval != ERROR_OK)
+			LOG_ERROR("Failed to write memory at 0x%08"PRIx32, address);
+		return retval;
+	}
+
 	while (nbytes > 0) {
 		uint32_t this_size = size;
 
@@ -484,6 +515,20 @@ static int mem_ap_read(struct adiv5_ap *ap, uint8_t *buffer, uint32_t size, uint
 	if (ap->unaligned_access_bad && (adr % size != 0))
 		return ERROR_TARGET_UNALIGNED_ACCESS;
 
+	/* A lone word next to the previous access (e.g. neighbouring debug
+	 * registers) goes through the banked registers, keeping TAR as is. */
+	if (size == 4 && count == 1 && addrinc && !dap->ti_be_32_quirks
+			&& (adr & 3) == 0 && mem_ap_tar_in_block(ap, adr)) {
+		uint32_t value;
+		retval = mem_ap_read_atomic_u32(ap, adr, &value);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Failed to read memory at 0x%08"PRIx32, adr);
+			return retval;
+		}
+		h_u32_to_le(buffer, value);
+		return ERROR_OK;
+	}
+
 	/* Allocate buffer to hold the sequence of DRW reads that will be made. This is a significant
 	 * over-allocation if packed transfers are going to be used, but determining the real need at
 	 * this point would be messy. */
@@ -784,6 +784,7 @@ void arm_free_reg_cache(struct arm *arm)
 	}
 
 	free(cache->reg_list[0].arch_info);
+	register_cache_index_free(cache);
 	free(cache->reg_list);
 	free(cache);
 
@@ -675,6 +675,7 @@ void armv7m_free_reg_cache(struct target *target)
 	}
 
 	free(cache->reg_list[0].arch_info);
+	register_cache_index_free(cache);
 	free(cache->reg_list);
 	free(cache);
 
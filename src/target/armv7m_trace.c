@@ -24,29 +24,277 @@
 #include <target/cortex_m.h>
 #include <target/armv7m_trace.h>
 #include <jtag/interface.h>
+#include <server/server.h>
+
+#define TRACE_BUF_SIZE	65536
+/* adapter reads per timer tick, bounds the time spent draining a busy link */
+#define TRACE_POLL_MAX	16
+
+/* distinct PC values tracked by the PC sample histogram */
+#define ITM_PC_HIST_SIZE	1024
+/* exception numbers reported by DWT exception trace packets */
+#define ITM_NUM_EXCEPTIONS	512
+/* a synchronization packet is at least 47 zero bits followed by a one */
+#define ITM_SYNC_ZEROS		5
+
+/* DWT hardware source packet discriminators */
+#define DWT_ID_EVENT_COUNTER	0
+#define DWT_ID_EXCEPTION	1
+#define DWT_ID_PC_SAMPLE	2
+
+static uint8_t trace_buf[TRACE_BUF_SIZE];
+
+enum itm_decode_state {
+	ITM_STATE_HEADER,	/* waiting for a packet header */
+	ITM_STATE_SOURCE,	/* collecting a source packet payload */
+	ITM_STATE_PROTOCOL,	/* collecting a protocol packet continuation */
+};
+
+struct itm_pc_bucket {
+	uint32_t pc;
+	uint32_t count;
+};
+
+struct armv7m_itm_decoder {
+	enum itm_decode_state state;
+	unsigned int zeros;
+	uint8_t header;
+	unsigned int payload_len;
+	unsigned int payload_got;
+	uint8_t payload[4];
+	uint64_t value;
+	unsigned int shift;
+
+	uint64_t bytes;
+	uint64_t syncs;
+	uint64_t overflows;
+	uint64_t local_timestamps;
+	uint64_t global_timestamps;
+	uint64_t extensions;
+	uint64_t reserved;
+	uint64_t timestamp;
+	uint64_t stim_packets[ITM_NUM_STIM_PORTS];
+	uint64_t event_counters;
+	uint64_t data_trace;
+	uint64_t pc_samples;
+	uint64_t pc_sleep;
+	uint64_t pc_untracked;
+	struct itm_pc_bucket pc_hist[ITM_PC_HIST_SIZE];
+	uint32_t exc_enter[ITM_NUM_EXCEPTIONS];
+	uint32_t exc_exit[ITM_NUM_EXCEPTIONS];
+	uint32_t exc_return[ITM_NUM_EXCEPTIONS];
+};
+
+struct armv7m_itm_service {
+	char *port;
+	/* known once the first client connected */
+	struct service *service;
+};
+
+static void itm_service_write(struct armv7m_itm_service *itm_service,
+		const uint8_t *data, unsigned int len)
+{
+	if (!itm_service || !itm_service->service)
+		return;
+
+	/* closed connections are reaped by the server loop on their next read */
+	for (struct connection *c = itm_service->service->connections; c; c = c->next)
+		connection_write(c, data, len);
+}
+
+static void itm_pc_sample(struct armv7m_itm_decoder *decoder, uint32_t pc)
+{
+	unsigned int i = ((pc >> 1) * 2654435761u) % ITM_PC_HIST_SIZE;
+
+	decoder->pc_samples++;
+
+	/* open addressing, give up after a short probe once the table fills */
+	for (unsigned int n = 0; n < 16; n++) {
+		struct itm_pc_bucket *bucket = &decoder->pc_hist[i];
+
+		if (bucket->count == 0)
+			bucket->pc = pc;
+		if (bucket->pc == pc) {
+			bucket->count++;
+			return;
+		}
+		i = (i + 1) % ITM_PC_HIST_SIZE;
+	}
+
+	decoder->pc_untracked++;
+}
+
+static void itm_hardware_packet(struct armv7m_itm_decoder *decoder,
+		unsigned int id, const uint8_t *payload, unsigned int len)
+{
+	switch (id) {
+	case DWT_ID_EVENT_COUNTER:
+		decoder->event_counters++;
+		break;
+	case DWT_ID_EXCEPTION:
+		if (len == 2) {
+			unsigned int number = payload[0] | ((payload[1] & 1) << 8);
+
+			switch ((payload[1] >> 4) & 3) {
+			case 1:
+				decoder->exc_enter[number]++;
+				break;
+			case 2:
+				decoder->exc_exit[number]++;
+				break;
+			case 3:
+				decoder->exc_return[number]++;
+				break;
+			}
+		}
+		break;
+	case DWT_ID_PC_SAMPLE:
+		if (len == 4)
+			itm_pc_sample(decoder, le_to_h_u32(payload));
+		else
+			decoder->pc_sleep++;
+		break;
+	default:
+		/* data trace PC, address and value packets */
+		if (id >= 8 && id <= 23)
+			decoder->data_trace++;
+		else
+			decoder->reserved++;
+		break;
+	}
+}
+
+static void itm_protocol_packet(struct armv7m_itm_decoder *decoder)
+{
+	uint8_t header = decoder->header;
+
+	if ((header & 0x0f) == 0) {
+		/* local timestamp, format 1 carries the delta in the payload */
+		if (header & 0x80)
+			decoder->timestamp += decoder->value;
+		else
+			decoder->timestamp += (header >> 4) & 7;
+		decoder->local_timestamps++;
+	} else if ((header & 0x08) == 0x08) {
+		decoder->extensions++;
+	} else if (header == 0x94 || header == 0xb4) {
+		decoder->global_timestamps++;
+	} else {
+		decoder->reserved++;
+	}
+}
+
+static void itm_source_packet(struct armv7m_trace_config *trace_config)
+{
+	struct armv7m_itm_decoder *decoder = trace_config->itm_decoder;
+	unsigned int id = decoder->header >> 3;
+
+	if (decoder->header & 0x04) {
+		itm_hardware_packet(decoder, id, decoder->payload, decoder->payload_len);
+	} else {
+		decoder->stim_packets[id]++;
+		itm_service_write(trace_config->itm_service[id],
+				decoder->payload, decoder->payload_len);
+	}
+}
+
+/*
+ * Incremental ITM/DWT packet decoder, see the ARMv7-M Architecture Reference
+ * Manual, appendix "ITM and DWT Packet Protocol". Packets may be split
+ * across adapter reads, so all state lives in the decoder.
+ */
+static void itm_decode(struct armv7m_trace_config *trace_config,
+		const uint8_t *buf, size_t size)
+{
+	struct armv7m_itm_decoder *decoder = trace_config->itm_decoder;
+
+	decoder->bytes += size;
+
+	for (size_t i = 0; i < size; i++) {
+		uint8_t byte = buf[i];
+
+		switch (decoder->state) {
+		case ITM_STATE_SOURCE:
+			decoder->payload[decoder->payload_got++] = byte;
+			if (decoder->payload_got == decoder->payload_len) {
+				itm_source_packet(trace_config);
+				decoder->state = ITM_STATE_HEADER;
+			}
+			continue;
+		case ITM_STATE_PROTOCOL:
+			decoder->value |= (uint64_t)(byte & 0x7f) << decoder->shift;
+			decoder->shift += 7;
+			if (!(byte & 0x80) || decoder->shift >= 64) {
+				itm_protocol_packet(decoder);
+				decoder->state = ITM_STATE_HEADER;
+			}
+			continue;
+		case ITM_STATE_HEADER:
+			break;
+		}
 
-#define TRACE_BUF_SIZE	4096
+		if (byte == 0x00) {
+			decoder->zeros++;
+			continue;
+		}
+		if (byte == 0x80 && decoder->zeros >= ITM_SYNC_ZEROS) {
+			decoder->zeros = 0;
+			decoder->syncs++;
+			continue;
+		}
+		decoder->zeros = 0;
+
+		decoder->header = byte;
+		if (byte & 0x03) {
+			/* source packet, the size field encodes 1, 2 or 4 bytes */
+			decoder->payload_len = (byte & 0x03) == 3 ? 4 : (byte & 0x03);
+			decoder->payload_got = 0;
+			decoder->state = ITM_STATE_SOURCE;
+		} else if (byte == 0x70) {
+			decoder->overflows++;
+		} else if (byte & 0x80) {
+			decoder->value = 0;
+			decoder->shift = 0;
+			decoder->state = ITM_STATE_PROTOCOL;
+		} else {
+			decoder->value = 0;
+			itm_protocol_packet(decoder);
+		}
+	}
+}
 
 static int armv7m_poll_trace(void *target)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
-	uint8_t buf[TRACE_BUF_SIZE];
-	size_t size = sizeof(buf);
+	struct armv7m_trace_config *trace_config = &armv7m->trace_config;
 	int retval;
 
-	retval = adapter_poll_trace(buf, &size);
-	if (retval != ERROR_OK || !size)
-		return retval;
+	/* drain what the adapter has buffered rather than one block per tick,
+	 * so SWO running at full line rate doesn't overrun the adapter */
+	for (unsigned int n = 0; n < TRACE_POLL_MAX; n++) {
+		size_t size = sizeof(trace_buf);
 
-	target_call_trace_callbacks(target, size, buf);
+		retval = adapter_poll_trace(trace_buf, &size);
+		if (retval != ERROR_OK || !size)
+			return retval;
 
-	if (armv7m->trace_config.trace_file != NULL) {
-		if (fwrite(buf, 1, size, armv7m->trace_config.trace_file) == size)
-			fflush(armv7m->trace_config.trace_file);
-		else {
-			LOG_ERROR("Error writing to the trace destination file");
-			return ERROR_FAIL;
+		target_call_trace_callbacks(target, size, trace_buf);
+
+		if (trace_config->itm_decode && trace_config->itm_decoder)
+			itm_decode(trace_config, trace_buf, size);
+
+		if (trace_config->trace_file != NULL) {
+			if (fwrite(trace_buf, 1, size, trace_config->trace_file) == size)
+				fflush(trace_config->trace_file);
+			else {
+				LOG_ERROR("Error writing to the trace destination file");
+				return ERROR_FAIL;
+			}
 		}
+
+		/* some adapters hand out one byte less than asked for */
+		if (size < sizeof(trace_buf) - 1)
+			break;
 	}
 
 	return ERROR_OK;
@@ -299,6 +547,208 @@ COMMAND_HANDLER(handle_itm_ports_command)
 		return ERROR_OK;
 }
 
+static int itm_decoder_enable(struct armv7m_trace_config *trace_config)
+{
+	if (!trace_config->itm_decoder) {
+		trace_config->itm_decoder = calloc(1, sizeof(struct armv7m_itm_decoder));
+		if (!trace_config->itm_decoder) {
+			LOG_ERROR("Out of memory");
+			return ERROR_FAIL;
+		}
+	}
+
+	trace_config->itm_decode = true;
+	return ERROR_OK;
+}
+
+COMMAND_HANDLER(handle_itm_decode_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	bool enable;
+
+	if (CMD_ARGC != 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_ON_OFF(CMD_ARGV[0], enable);
+	if (enable)
+		return itm_decoder_enable(&armv7m->trace_config);
+
+	armv7m->trace_config.itm_decode = false;
+	return ERROR_OK;
+}
+
+static int itm_service_new_connection(struct connection *connection)
+{
+	struct armv7m_itm_service *itm_service = connection->service->priv;
+
+	itm_service->service = connection->service;
+	return ERROR_OK;
+}
+
+static int itm_service_input(struct connection *connection)
+{
+	uint8_t buf[64];
+	int bytes_read;
+
+	/* stimulus ports are output only, discard whatever the client sends */
+	bytes_read = connection_read(connection, buf, sizeof(buf));
+	if (bytes_read == 0)
+		return ERROR_SERVER_REMOTE_CLOSED;
+	else if (bytes_read == -1) {
+		LOG_ERROR("error during read: %s", strerror(errno));
+		return ERROR_SERVER_REMOTE_CLOSED;
+	}
+
+	return ERROR_OK;
+}
+
+static int itm_service_connection_closed(struct connection *connection)
+{
+	return ERROR_OK;
+}
+
+static void itm_service_stop(struct armv7m_trace_config *trace_config, unsigned int port)
+{
+	struct armv7m_itm_service *itm_service = trace_config->itm_service[port];
+	char *tcp_port;
+
+	if (!itm_service)
+		return;
+
+	/* remove_service() frees the service private data */
+	tcp_port = itm_service->port;
+	remove_service("itm", tcp_port);
+	free(tcp_port);
+	trace_config->itm_service[port] = NULL;
+}
+
+COMMAND_HANDLER(handle_itm_tcp_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct armv7m_trace_config *trace_config = &armv7m->trace_config;
+	struct armv7m_itm_service *itm_service;
+	unsigned int port;
+	int retval;
+
+	if (CMD_ARGC != 2)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	COMMAND_PARSE_NUMBER(uint, CMD_ARGV[0], port);
+	if (port >= ITM_NUM_STIM_PORTS) {
+		command_print(CMD, "stimulus port must be below %d", ITM_NUM_STIM_PORTS);
+		return ERROR_COMMAND_ARGUMENT_INVALID;
+	}
+
+	itm_service_stop(trace_config, port);
+	if (!strcmp(CMD_ARGV[1], "off"))
+		return ERROR_OK;
+
+	retval = itm_decoder_enable(trace_config);
+	if (retval != ERROR_OK)
+		return retval;
+
+	itm_service = calloc(1, sizeof(*itm_service));
+	if (!itm_service) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	itm_service->port = strdup(CMD_ARGV[1]);
+	if (!itm_service->port) {
+		free(itm_service);
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	retval = add_service("itm", itm_service->port, CONNECTION_LIMIT_UNLIMITED,
+			itm_service_new_connection, itm_service_input,
+			itm_service_connection_closed, itm_service);
+	if (retval != ERROR_OK) {
+		free(itm_service->port);
+		free(itm_service);
+		return retval;
+	}
+
+	trace_config->itm_service[port] = itm_service;
+	return ERROR_OK;
+}
+
+static int itm_pc_bucket_compare(const void *a, const void *b)
+{
+	const struct itm_pc_bucket *ba = a;
+	const struct itm_pc_bucket *bb = b;
+
+	if (ba->count != bb->count)
+		return (ba->count > bb->count) ? -1 : 1;
+	return (ba->pc > bb->pc) - (ba->pc < bb->pc);
+}
+
+COMMAND_HANDLER(handle_itm_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct armv7m_itm_decoder *decoder = armv7m->trace_config.itm_decoder;
+
+	if (CMD_ARGC > 1)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	if (!decoder) {
+		command_print(CMD, "ITM decoding was never enabled");
+		return ERROR_OK;
+	}
+
+	if (CMD_ARGC == 1) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		memset(decoder, 0, sizeof(*decoder));
+		return ERROR_OK;
+	}
+
+	command_print(CMD, "bytes %" PRIu64 ", syncs %" PRIu64 ", overflows %" PRIu64
+			", reserved %" PRIu64, decoder->bytes, decoder->syncs,
+			decoder->overflows, decoder->reserved);
+	command_print(CMD, "timestamps: local %" PRIu64 " (time %" PRIu64 "), global %" PRIu64
+			", extensions %" PRIu64, decoder->local_timestamps, decoder->timestamp,
+			decoder->global_timestamps, decoder->extensions);
+
+	for (unsigned int i = 0; i < ITM_NUM_STIM_PORTS; i++) {
+		if (decoder->stim_packets[i])
+			command_print(CMD, "stimulus port %u: %" PRIu64 " packets",
+					i, decoder->stim_packets[i]);
+	}
+
+	command_print(CMD, "event counter packets %" PRIu64 ", data trace packets %" PRIu64,
+			decoder->event_counters, decoder->data_trace);
+
+	for (unsigned int i = 0; i < ITM_NUM_EXCEPTIONS; i++) {
+		if (decoder->exc_enter[i] || decoder->exc_exit[i] || decoder->exc_return[i])
+			command_print(CMD, "exception %u: entered %" PRIu32 ", exited %" PRIu32
+					", returned %" PRIu32, i, decoder->exc_enter[i],
+					decoder->exc_exit[i], decoder->exc_return[i]);
+	}
+
+	command_print(CMD, "PC samples %" PRIu64 ", sleeping %" PRIu64 ", untracked %" PRIu64,
+			decoder->pc_samples, decoder->pc_sleep, decoder->pc_untracked);
+	if (!decoder->pc_samples)
+		return ERROR_OK;
+
+	struct itm_pc_bucket *hist = malloc(sizeof(decoder->pc_hist));
+	if (!hist) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+	memcpy(hist, decoder->pc_hist, sizeof(decoder->pc_hist));
+	qsort(hist, ITM_PC_HIST_SIZE, sizeof(*hist), itm_pc_bucket_compare);
+
+	for (unsigned int i = 0; i < 10 && hist[i].count; i++)
+		command_print(CMD, "  0x%08" PRIx32 " %" PRIu32 " (%u%%)", hist[i].pc, hist[i].count,
+				(unsigned int)(hist[i].count * 100ULL / decoder->pc_samples));
+
+	free(hist);
+	return ERROR_OK;
+}
+
 static const struct command_registration tpiu_command_handlers[] = {
 	{
 		.name = "config",
@@ -328,6 +778,27 @@ static const struct command_registration itm_command_handlers[] = {
 		.help = "Enable or disable all ITM stimulus ports",
 		.usage = "(0|1|on|off)",
 	},
+	{
+		.name = "decode",
+		.handler = handle_itm_decode_command,
+		.mode = COMMAND_ANY,
+		.help = "Enable or disable decoding of captured ITM/DWT packets",
+		.usage = "(0|1|on|off)",
+	},
+	{
+		.name = "tcp",
+		.handler = handle_itm_tcp_command,
+		.mode = COMMAND_EXEC,
+		.help = "Serve the payload of an ITM stimulus port on a TCP port",
+		.usage = "<port> (<tcp_port>|off)",
+	},
+	{
+		.name = "stats",
+		.handler = handle_itm_stats_command,
+		.mode = COMMAND_EXEC,
+		.help = "Show or reset statistics of the ITM/DWT decoder",
+		.usage = "['reset']",
+	},
 	COMMAND_REGISTRATION_DONE
 };
 
@@ -45,6 +45,12 @@ enum itm_ts_prescaler {
 	ITM_TS_PRESCALE64,	/**< refclock divided by 64 for the timestamp counter */
 };
 
+/** Number of stimulus ports addressable by an ITM source packet */
+#define ITM_NUM_STIM_PORTS	32
+
+struct armv7m_itm_decoder;
+struct armv7m_itm_service;
+
 struct armv7m_trace_config {
 	/** Currently active trace capture mode */
 	enum trace_config_type config_type;
@@ -75,6 +81,13 @@ struct armv7m_trace_config {
 	unsigned int trace_freq;
 	/** Handle to output trace data in INTERNAL capture mode */
 	FILE *trace_file;
+
+	/** Decode captured ITM/DWT packets in INTERNAL capture mode */
+	bool itm_decode;
+	/** Decoder state and statistics, allocated on first use */
+	struct armv7m_itm_decoder *itm_decoder;
+	/** TCP services forwarding the payload of each stimulus port */
+	struct armv7m_itm_service *itm_service[ITM_NUM_STIM_PORTS];
 };
 
 extern const struct command_registration armv7m_trace_command_handlers[];
@@ -1723,6 +1723,7 @@ static void armv8_free_cache(struct reg_cache *cache, bool regs32)
 
 	if (!regs32)
 		free(cache->reg_list[0].arch_info);
+	register_cache_index_free(cache);
 	free(cache->reg_list);
 	free(cache);
 }
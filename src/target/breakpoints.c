@@ -24,6 +24,7 @@
 #endif
 
 #include "target.h"
+#include "target_type.h"
 #include <helper/log.h>
 #include "breakpoints.h"
 
@@ -41,33 +42,164 @@ static const char * const watchpoint_rw_strings[] = {
 /* monotonic counter/id-number for breakpoints and watch points */
 static int bpwp_unique_id;
 
+#define BREAKPOINT_INDEX_MIN_SIZE	64
+
+/*
+ * Address index over target->breakpoints. Coverage and tracing tools plant
+ * thousands of breakpoints, and breakpoint_find() is called on every resume
+ * and halt. Buckets are chained through breakpoint->hash_next in list order,
+ * so lookups return the same breakpoint a list walk would.
+ */
+struct breakpoint_index {
+	unsigned int size;		/* number of buckets, a power of two */
+	unsigned int count;		/* number of indexed breakpoints */
+	struct breakpoint *tail;	/* last breakpoint in target->breakpoints */
+	struct breakpoint **buckets;
+};
+
+static unsigned int breakpoint_hash(target_addr_t address, unsigned int size)
+{
+	return (unsigned int)(((uint64_t)address * 0x9e3779b97f4a7c15ULL) >> 32) & (size - 1);
+}
+
+static void breakpoint_index_link(struct breakpoint_index *index,
+		struct breakpoint *breakpoint)
+{
+	struct breakpoint **p = &index->buckets[breakpoint_hash(breakpoint->address, index->size)];
+
+	while (*p)
+		p = &(*p)->hash_next;
+	breakpoint->hash_next = NULL;
+	*p = breakpoint;
+}
+
+static int breakpoint_index_resize(struct target *target, unsigned int size)
+{
+	struct breakpoint_index *index = target->breakpoint_index;
+	struct breakpoint **buckets = calloc(size, sizeof(*buckets));
+
+	if (!buckets) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	free(index->buckets);
+	index->buckets = buckets;
+	index->size = size;
+	for (struct breakpoint *b = target->breakpoints; b; b = b->next)
+		breakpoint_index_link(index, b);
+
+	return ERROR_OK;
+}
+
+static struct breakpoint_index *breakpoint_index_get(struct target *target)
+{
+	struct breakpoint_index *index = target->breakpoint_index;
+
+	if (index)
+		return index;
+
+	index = calloc(1, sizeof(*index));
+	if (!index) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+	target->breakpoint_index = index;
+
+	if (breakpoint_index_resize(target, BREAKPOINT_INDEX_MIN_SIZE) != ERROR_OK) {
+		free(index);
+		target->breakpoint_index = NULL;
+		return NULL;
+	}
+
+	for (struct breakpoint *b = target->breakpoints; b; b = b->next) {
+		index->tail = b;
+		index->count++;
+	}
+
+	return index;
+}
+
+/* index a breakpoint which was just appended to target->breakpoints */
+static void breakpoint_index_add(struct target *target, struct breakpoint *breakpoint)
+{
+	struct breakpoint_index *index = target->breakpoint_index;
+
+	if (!index)
+		return;
+
+	breakpoint_index_link(index, breakpoint);
+	index->tail = breakpoint;
+	index->count++;
+
+	/* a failed resize leaves the index usable, just with longer chains */
+	if (index->count > 2 * index->size)
+		breakpoint_index_resize(target, 2 * index->size);
+}
+
+/* drop a breakpoint from the index, prev is its predecessor in the list */
+static void breakpoint_index_del(struct target *target, struct breakpoint *breakpoint,
+		struct breakpoint *prev)
+{
+	struct breakpoint_index *index = target->breakpoint_index;
+	struct breakpoint **p;
+
+	if (!index)
+		return;
+
+	p = &index->buckets[breakpoint_hash(breakpoint->address, index->size)];
+	while (*p && *p != breakpoint)
+		p = &(*p)->hash_next;
+	if (*p) {
+		*p = breakpoint->hash_next;
+		index->count--;
+	}
+
+	if (index->tail == breakpoint)
+		index->tail = prev;
+}
+
+void breakpoint_index_free(struct target *target)
+{
+	struct breakpoint_index *index = target->breakpoint_index;
+
+	if (!index)
+		return;
+
+	free(index->buckets);
+	free(index);
+	target->breakpoint_index = NULL;
+}
+
 static int breakpoint_add_internal(struct target *target,
 	target_addr_t address,
 	uint32_t length,
 	enum breakpoint_type type)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
-	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint_index *index;
+	struct breakpoint *breakpoint;
+	struct breakpoint **breakpoint_p;
+	struct breakpoint *prev;
 	const char *reason;
 	int retval;
-	int n;
 
-	n = 0;
-	while (breakpoint) {
-		n++;
-		if (breakpoint->address == address) {
-			/* FIXME don't assume "same address" means "same
-			 * breakpoint" ... check all the parameters before
-			 * succeeding.
-			 */
-			LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
-				address, breakpoint->unique_id);
-			return ERROR_TARGET_DUPLICATE_BREAKPOINT;
-		}
-		breakpoint_p = &breakpoint->next;
-		breakpoint = breakpoint->next;
+	breakpoint = breakpoint_find(target, address);
+	if (breakpoint) {
+		/* FIXME don't assume "same address" means "same
+		 * breakpoint" ... check all the parameters before
+		 * succeeding.
+		 */
+		LOG_ERROR("Duplicate Breakpoint address: " TARGET_ADDR_FMT " (BP %" PRIu32 ")",
+			address, breakpoint->unique_id);
+		return ERROR_TARGET_DUPLICATE_BREAKPOINT;
 	}
 
+	index = breakpoint_index_get(target);
+	if (!index)
+		return ERROR_FAIL;
+	prev = index->tail;
+	breakpoint_p = prev ? &prev->next : &target->breakpoints;
+
 	(*breakpoint_p) = malloc(sizeof(struct breakpoint));
 	(*breakpoint_p)->address = address;
 	(*breakpoint_p)->asid = 0;
@@ -76,8 +208,11 @@ static int breakpoint_add_internal(struct target *target,
 	(*breakpoint_p)->set = 0;
 	(*breakpoint_p)->orig_instr = malloc(length);
 	(*breakpoint_p)->next = NULL;
+	(*breakpoint_p)->hash_next = NULL;
 	(*breakpoint_p)->unique_id = bpwp_unique_id++;
 
+	/* the target may adjust the address (e.g. MIPS64 sign extension),
+	 * so only hash it once the target accepted the breakpoint */
 	retval = target_add_breakpoint(target, *breakpoint_p);
 	switch (retval) {
 		case ERROR_OK:
@@ -98,6 +233,8 @@ fail:
 			return retval;
 	}
 
+	breakpoint_index_add(target, *breakpoint_p);
+
 	LOG_DEBUG("added %s breakpoint at " TARGET_ADDR_FMT " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
 		(*breakpoint_p)->address, (*breakpoint_p)->length,
@@ -140,6 +277,7 @@ static int context_breakpoint_add_internal(struct target *target,
 	(*breakpoint_p)->set = 0;
 	(*breakpoint_p)->orig_instr = malloc(length);
 	(*breakpoint_p)->next = NULL;
+	(*breakpoint_p)->hash_next = NULL;
 	(*breakpoint_p)->unique_id = bpwp_unique_id++;
 	retval = target_add_context_breakpoint(target, *breakpoint_p);
 	if (retval != ERROR_OK) {
@@ -150,6 +288,8 @@ static int context_breakpoint_add_internal(struct target *target,
 		return retval;
 	}
 
+	breakpoint_index_add(target, *breakpoint_p);
+
 	LOG_DEBUG("added %s Context breakpoint at 0x%8.8" PRIx32 " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
 		(*breakpoint_p)->asid, (*breakpoint_p)->length,
@@ -196,6 +336,7 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 	(*breakpoint_p)->set = 0;
 	(*breakpoint_p)->orig_instr = malloc(length);
 	(*breakpoint_p)->next = NULL;
+	(*breakpoint_p)->hash_next = NULL;
 	(*breakpoint_p)->unique_id = bpwp_unique_id++;
 
 
@@ -207,6 +348,7 @@ static int hybrid_breakpoint_add_internal(struct target *target,
 		*breakpoint_p = NULL;
 		return retval;
 	}
+	breakpoint_index_add(target, *breakpoint_p);
 	LOG_DEBUG(
 		"added %s Hybrid breakpoint at address " TARGET_ADDR_FMT " of length 0x%8.8x, (BPID: %" PRIu32 ")",
 		breakpoint_type_strings[(*breakpoint_p)->type],
@@ -292,11 +434,13 @@ static void breakpoint_free(struct target *target, struct breakpoint *breakpoint
 {
 	struct breakpoint *breakpoint = target->breakpoints;
 	struct breakpoint **breakpoint_p = &target->breakpoints;
+	struct breakpoint *prev = NULL;
 	int retval;
 
 	while (breakpoint) {
 		if (breakpoint == breakpoint_to_remove)
 			break;
+		prev = breakpoint;
 		breakpoint_p = &breakpoint->next;
 		breakpoint = breakpoint->next;
 	}
@@ -308,19 +452,24 @@ static void breakpoint_free(struct target *target, struct breakpoint *breakpoint
 
 	LOG_DEBUG("free BPID: %" PRIu32 " --> %d", breakpoint->unique_id, retval);
 	(*breakpoint_p) = breakpoint->next;
+	breakpoint_index_del(target, breakpoint, prev);
 	free(breakpoint->orig_instr);
 	free(breakpoint);
+
+	if (!target->breakpoints)
+		breakpoint_index_free(target);
 }
 
 static int breakpoint_remove_internal(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint *breakpoint = breakpoint_find(target, address);
 
-	while (breakpoint) {
-		if ((breakpoint->address == address) ||
-		    (breakpoint->address == 0 && breakpoint->asid == address))
-			break;
-		breakpoint = breakpoint->next;
+	/* context breakpoints are identified by their asid */
+	if (!breakpoint) {
+		for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+			if (breakpoint->address == 0 && breakpoint->asid == address)
+				break;
+		}
 	}
 
 	if (breakpoint) {
@@ -402,10 +551,71 @@ void breakpoint_clear_target(struct target *target)
 
 }
 
+static void breakpoint_batch_begin_internal(struct target *target)
+{
+	/* only targets which can apply the changes in bulk defer them */
+	if (target->type->flush_breakpoints)
+		target->breakpoint_batch = true;
+}
+
+void breakpoint_batch_begin(struct target *target)
+{
+	if (target->smp) {
+		struct target_list *head;
+		for (head = target->head; head != NULL; head = head->next)
+			breakpoint_batch_begin_internal(head->target);
+	} else
+		breakpoint_batch_begin_internal(target);
+}
+
+static int breakpoint_batch_end_internal(struct target *target)
+{
+	int retval;
+
+	if (!target->breakpoint_batch)
+		return ERROR_OK;
+
+	target->breakpoint_batch = false;
+	retval = target->type->flush_breakpoints(target);
+	if (retval != ERROR_OK)
+		LOG_ERROR("failed to apply breakpoint changes on %s", target_name(target));
+
+	return retval;
+}
+
+int breakpoint_batch_end(struct target *target)
+{
+	int retval = ERROR_OK;
+
+	if (target->smp) {
+		struct target_list *head;
+		for (head = target->head; head != NULL; head = head->next) {
+			int ret = breakpoint_batch_end_internal(head->target);
+			if (ret != ERROR_OK)
+				retval = ret;
+		}
+	} else
+		retval = breakpoint_batch_end_internal(target);
+
+	return retval;
+}
+
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address)
 {
-	struct breakpoint *breakpoint = target->breakpoints;
+	struct breakpoint_index *index = target->breakpoint_index;
+	struct breakpoint *breakpoint;
+
+	if (index) {
+		breakpoint = index->buckets[breakpoint_hash(address, index->size)];
+		while (breakpoint) {
+			if (breakpoint->address == address)
+				return breakpoint;
+			breakpoint = breakpoint->hash_next;
+		}
+		return NULL;
+	}
 
+	breakpoint = target->breakpoints;
 	while (breakpoint) {
 		if (breakpoint->address == address)
 			return breakpoint;
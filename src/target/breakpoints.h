@@ -40,6 +40,7 @@ struct breakpoint {
 	int set;
 	uint8_t *orig_instr;
 	struct breakpoint *next;
+	struct breakpoint *hash_next;	/* next breakpoint in the same index bucket */
 	uint32_t unique_id;
 	int linked_BRP;
 };
@@ -66,6 +67,11 @@ void breakpoint_remove(struct target *target, target_addr_t address);
 void breakpoint_remove_all(struct target *target);
 
 struct breakpoint *breakpoint_find(struct target *target, target_addr_t address);
+void breakpoint_index_free(struct target *target);
+
+/* defer software breakpoint memory updates until breakpoint_batch_end() */
+void breakpoint_batch_begin(struct target *target);
+int breakpoint_batch_end(struct target *target);
 
 void watchpoint_clear_target(struct target *target);
 int watchpoint_add(struct target *target,
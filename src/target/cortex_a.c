@@ -635,21 +635,171 @@ static struct target *get_cortex_a(struct target *target, int32_t coreid)
 	}
 	return target;
 }
-static int cortex_a_halt(struct target *target);
 
-static int cortex_a_halt_smp(struct target *target)
+/*
+ * Collect the examined cores of the SMP group of target, except target
+ * itself, whose state differs from 'state'. Returns a malloc'ed array.
+ */
+static struct target **cortex_a_smp_cores(struct target *target,
+	enum target_state state, unsigned int *p_count)
 {
-	int retval = 0;
 	struct target_list *head;
-	struct target *curr;
-	head = target->head;
-	while (head != (struct target_list *)NULL) {
-		curr = head->target;
-		if ((curr != target) && (curr->state != TARGET_HALTED)
+	struct target **cores;
+	unsigned int count = 0;
+
+	foreach_smp_target(head, target->head)
+		count++;
+
+	cores = calloc(count ? count : 1, sizeof(*cores));
+	if (cores == NULL) {
+		LOG_ERROR("Out of memory");
+		return NULL;
+	}
+
+	count = 0;
+	foreach_smp_target(head, target->head) {
+		struct target *curr = head->target;
+		if ((curr != target) && (curr->state != state)
 			&& target_was_examined(curr))
-			retval += cortex_a_halt(curr);
-		head = head->next;
+			cores[count++] = curr;
+	}
+
+	*p_count = count;
+	return cores;
+}
+
+/* Flush the queue of every DAP used by cores[], each DAP only once. */
+static int cortex_a_run_cores(struct target **cores, unsigned int count)
+{
+	for (unsigned int i = 0; i < count; i++) {
+		struct adiv5_dap *dap = target_to_armv7a(cores[i])->debug_ap->dap;
+		unsigned int j;
+
+		for (j = 0; j < i; j++)
+			if (target_to_armv7a(cores[j])->debug_ap->dap == dap)
+				break;
+		if (j < i)
+			continue;
+
+		int retval = dap_run(dap);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+	return ERROR_OK;
+}
+
+/*
+ * Multi-core version of cortex_a_wait_dscr_bits(): the DSCR of all cores
+ * still waiting is read in one queued transaction per DAP. If 'when' is
+ * not NULL it receives the time in ms after which each core matched.
+ */
+static int cortex_a_wait_dscr_bits_smp(struct target **cores, unsigned int count,
+	uint32_t mask, uint32_t value, uint32_t *dscr, int64_t *when)
+{
+	int64_t then = timeval_ms();
+	int retval;
+
+	while (1) {
+		bool done = true;
+
+		for (unsigned int i = 0; i < count; i++) {
+			struct armv7a_common *armv7a = target_to_armv7a(cores[i]);
+
+			if ((dscr[i] & mask) == value)
+				continue;
+			retval = mem_ap_read_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_DSCR, &dscr[i]);
+			if (retval != ERROR_OK)
+				return retval;
+			done = false;
+		}
+		if (done)
+			break;
+
+		retval = cortex_a_run_cores(cores, count);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("Could not read DSCR register");
+			return retval;
+		}
+
+		int64_t now = timeval_ms();
+		done = true;
+		for (unsigned int i = 0; i < count; i++) {
+			if ((dscr[i] & mask) != value)
+				done = false;
+			else if (when && when[i] < 0)
+				when[i] = now - then;
+		}
+		if (done)
+			break;
+
+		if (now > then + 1000) {
+			LOG_ERROR("timeout waiting for DSCR bit change");
+			return ERROR_FAIL;
+		}
 	}
+	return ERROR_OK;
+}
+
+/*
+ * Halt all other cores of the SMP group together: the halt requests of all
+ * cores are queued before the DAP is flushed and their DSCR is then polled
+ * as a group, so cores don't wait for each other's halt round trip.
+ */
+static int cortex_a_halt_smp(struct target *target)
+{
+	struct target **cores;
+	uint32_t *dscr = NULL;
+	int64_t *when = NULL;
+	unsigned int count;
+	int retval;
+
+	cores = cortex_a_smp_cores(target, TARGET_HALTED, &count);
+	if (cores == NULL)
+		return ERROR_FAIL;
+	if (count == 0) {
+		free(cores);
+		return ERROR_OK;
+	}
+
+	dscr = calloc(count, sizeof(*dscr));
+	when = calloc(count, sizeof(*when));
+	if (dscr == NULL || when == NULL) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto out;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct armv7a_common *armv7a = target_to_armv7a(cores[i]);
+
+		retval = mem_ap_write_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DRCR, DRCR_HALT);
+		if (retval != ERROR_OK)
+			goto out;
+		when[i] = -1;
+	}
+	retval = cortex_a_run_cores(cores, count);
+	if (retval != ERROR_OK)
+		goto out;
+
+	retval = cortex_a_wait_dscr_bits_smp(cores, count, DSCR_CORE_HALTED,
+			DSCR_CORE_HALTED, dscr, when);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error waiting for halt");
+		goto out;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		cores[i]->debug_reason = DBG_REASON_DBGRQ;
+		LOG_DEBUG("%s halted after %" PRId64 " ms",
+				target_name(cores[i]), when[i]);
+	}
+
+out:
+	free(when);
+	free(dscr);
+	free(cores);
 	return retval;
 }
 
@@ -932,25 +1082,94 @@ static int cortex_a_internal_restart(struct target *target)
 	return ERROR_OK;
 }
 
+/*
+ * Restart several cores at once, see cortex_a_internal_restart(). Each step
+ * is queued for all cores before the DAP is flushed.
+ */
+static int cortex_a_internal_restart_smp(struct target **cores, unsigned int count)
+{
+	uint32_t *dscr;
+	int retval;
+
+	dscr = calloc(count, sizeof(*dscr));
+	if (dscr == NULL) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct armv7a_common *armv7a = target_to_armv7a(cores[i]);
+
+		retval = mem_ap_read_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DSCR, &dscr[i]);
+		if (retval != ERROR_OK)
+			goto out;
+	}
+	retval = cortex_a_run_cores(cores, count);
+	if (retval != ERROR_OK)
+		goto out;
+
+	for (unsigned int i = 0; i < count; i++) {
+		struct armv7a_common *armv7a = target_to_armv7a(cores[i]);
+
+		if ((dscr[i] & DSCR_INSTR_COMP) == 0)
+			LOG_ERROR("DSCR InstrCompl must be set before leaving debug!");
+
+		retval = mem_ap_write_u32(armv7a->debug_ap,
+				armv7a->debug_base + CPUDBG_DSCR, dscr[i] & ~DSCR_ITR_EN);
+		if (retval == ERROR_OK)
+			retval = mem_ap_write_u32(armv7a->debug_ap,
+					armv7a->debug_base + CPUDBG_DRCR, DRCR_RESTART |
+					DRCR_CLEAR_EXCEPTIONS);
+		if (retval != ERROR_OK)
+			goto out;
+		dscr[i] = 0; /* force read of dscr */
+	}
+	retval = cortex_a_run_cores(cores, count);
+	if (retval != ERROR_OK)
+		goto out;
+
+	retval = cortex_a_wait_dscr_bits_smp(cores, count, DSCR_CORE_RESTARTED,
+			DSCR_CORE_RESTARTED, dscr, NULL);
+	if (retval != ERROR_OK) {
+		LOG_ERROR("Error waiting for resume");
+		goto out;
+	}
+
+	for (unsigned int i = 0; i < count; i++) {
+		cores[i]->debug_reason = DBG_REASON_NOTHALTED;
+		cores[i]->state = TARGET_RUNNING;
+
+		/* registers are now invalid */
+		register_cache_invalidate(target_to_armv7a(cores[i])->arm.core_cache);
+	}
+
+out:
+	free(dscr);
+	return retval;
+}
+
 static int cortex_a_restore_smp(struct target *target, int handle_breakpoints)
 {
 	int retval = 0;
-	struct target_list *head;
-	struct target *curr;
+	struct target **cores;
+	unsigned int count;
 	target_addr_t address;
-	head = target->head;
-	while (head != (struct target_list *)NULL) {
-		curr = head->target;
-		if ((curr != target) && (curr->state != TARGET_RUNNING)
-			&& target_was_examined(curr)) {
-			/*  resume current address , not in step mode */
-			retval += cortex_a_internal_restore(curr, 1, &address,
-					handle_breakpoints, 0);
-			retval += cortex_a_internal_restart(curr);
-		}
-		head = head->next;
 
+	cores = cortex_a_smp_cores(target, TARGET_RUNNING, &count);
+	if (cores == NULL)
+		return ERROR_FAIL;
+
+	/* restore the context of all cores first, then restart them together */
+	for (unsigned int i = 0; i < count; i++) {
+		/*  resume current address , not in step mode */
+		retval += cortex_a_internal_restore(cores[i], 1, &address,
+				handle_breakpoints, 0);
 	}
+	if (count)
+		retval += cortex_a_internal_restart_smp(cores, count);
+
+	free(cores);
 	return retval;
 }
 
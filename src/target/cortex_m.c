@@ -89,6 +89,187 @@ static int cortexm_dap_read_coreregister_u32(struct target *target,
 	return retval;
 }
 
+/* Queue a core register read through DCRSR/DCRDR. DHCSR is sampled between
+ * the selection and the data read, so that S_REGRDY can be checked once the
+ * queue has been run.
+ */
+static int cortex_m_queue_read_coreregister(struct target *target,
+	uint32_t regsel, uint32_t *value, uint32_t *dhcsr)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	int retval;
+
+	retval = mem_ap_write_u32(armv7m->debug_ap, DCB_DCRSR, regsel);
+	if (retval != ERROR_OK)
+		return retval;
+
+	retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DHCSR, dhcsr);
+	if (retval != ERROR_OK)
+		return retval;
+
+	return mem_ap_read_u32(armv7m->debug_ap, DCB_DCRDR, value);
+}
+
+/* Enough 32-bit transfers for all registers: D0-D15 need two each, and the
+ * four special registers share a single one. */
+#define CORTEX_M_MAX_REG_WORDS	(ARMV7M_LAST_REG + 16)
+
+/* Read every invalid register of the core cache with all DCRSR/DCRDR
+ * transfers queued in a single adapter round trip. Returns
+ * ERROR_TIMEOUT_REACHED when any transfer completed before S_REGRDY,
+ * in which case the caller falls back to register by register reads.
+ */
+static int cortex_m_fast_read_all_regs(struct target *target)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	uint32_t r_vals[CORTEX_M_MAX_REG_WORDS];
+	uint32_t dhcsr[CORTEX_M_MAX_REG_WORDS];
+	unsigned int word_idx[ARMV7M_LAST_REG];
+	unsigned int wi = 0;
+	unsigned int special_idx = CORTEX_M_MAX_REG_WORDS;
+	uint32_t dcrdr;
+	int retval;
+
+	assert(cache->num_regs <= ARMV7M_LAST_REG);
+
+	/* because the DCB_DCRDR is used for the emulated dcc channel
+	 * we have to save/restore the DCB_DCRDR when used */
+	if (target->dbg_msg_enabled) {
+		retval = mem_ap_read_u32(armv7m->debug_ap, DCB_DCRDR, &dcrdr);
+		if (retval != ERROR_OK)
+			goto flush;
+	}
+
+	for (unsigned int i = 0; i < cache->num_regs; i++) {
+		struct reg *r = &cache->reg_list[i];
+		unsigned int num = ((struct arm_reg *)r->arch_info)->num;
+
+		if (r->valid)
+			continue;
+
+		switch (num) {
+		case ARMV7M_R0 ... ARMV7M_PSP:
+			word_idx[i] = wi;
+			retval = cortex_m_queue_read_coreregister(target, num,
+					&r_vals[wi], &dhcsr[wi]);
+			wi++;
+			break;
+
+		case ARMV7M_PRIMASK ... ARMV7M_CONTROL:
+			/* packed in one Debug Core register, fetch it once */
+			if (special_idx == CORTEX_M_MAX_REG_WORDS) {
+				special_idx = wi;
+				retval = cortex_m_queue_read_coreregister(target, 20,
+						&r_vals[wi], &dhcsr[wi]);
+				wi++;
+			}
+			word_idx[i] = special_idx;
+			break;
+
+		case ARMV7M_D0 ... ARMV7M_D15:
+			word_idx[i] = wi;
+			retval = cortex_m_queue_read_coreregister(target,
+					(num - ARMV7M_D0) * 2 + 0x40, &r_vals[wi], &dhcsr[wi]);
+			if (retval != ERROR_OK)
+				goto flush;
+			wi++;
+			retval = cortex_m_queue_read_coreregister(target,
+					(num - ARMV7M_D0) * 2 + 0x41, &r_vals[wi], &dhcsr[wi]);
+			wi++;
+			break;
+
+		case ARMV7M_FPSCR:
+			word_idx[i] = wi;
+			retval = cortex_m_queue_read_coreregister(target, 0x21,
+					&r_vals[wi], &dhcsr[wi]);
+			wi++;
+			break;
+
+		default:
+			/* not reachable through DCRSR, leave it to the slow path */
+			word_idx[i] = CORTEX_M_MAX_REG_WORDS;
+			retval = ERROR_OK;
+			break;
+		}
+
+		if (retval != ERROR_OK)
+			goto flush;
+	}
+
+	retval = dap_run(armv7m->debug_ap->dap);
+	if (retval != ERROR_OK)
+		return retval;
+
+	/* don't lose reset and retire events signalled by the extra DHCSR reads */
+	for (unsigned int i = 0; i < wi; i++)
+		cortex_m->dcb_dhcsr |= dhcsr[i] & (S_RESET_ST | S_RETIRE_ST);
+
+	if (target->dbg_msg_enabled) {
+		/* restore DCB_DCRDR - this needs to be in a separate
+		 * transaction otherwise the emulated DCC channel breaks */
+		retval = mem_ap_write_atomic_u32(armv7m->debug_ap, DCB_DCRDR, dcrdr);
+		if (retval != ERROR_OK)
+			return retval;
+	}
+
+	for (unsigned int i = 0; i < wi; i++) {
+		if (!(dhcsr[i] & S_REGRDY)) {
+			LOG_DEBUG("register transfer %u not ready during fast read", i);
+			return ERROR_TIMEOUT_REACHED;
+		}
+	}
+
+	for (unsigned int i = 0; i < cache->num_regs; i++) {
+		struct reg *r = &cache->reg_list[i];
+		unsigned int num = ((struct arm_reg *)r->arch_info)->num;
+		unsigned int idx = word_idx[i];
+		uint32_t value;
+
+		if (r->valid || idx == CORTEX_M_MAX_REG_WORDS)
+			continue;
+
+		value = r_vals[idx];
+		switch (num) {
+		case ARMV7M_PRIMASK:
+			value = buf_get_u32((uint8_t *)&r_vals[idx], 0, 1);
+			break;
+		case ARMV7M_BASEPRI:
+			value = buf_get_u32((uint8_t *)&r_vals[idx], 8, 8);
+			break;
+		case ARMV7M_FAULTMASK:
+			value = buf_get_u32((uint8_t *)&r_vals[idx], 16, 1);
+			break;
+		case ARMV7M_CONTROL:
+			value = buf_get_u32((uint8_t *)&r_vals[idx], 24, 2);
+			break;
+		case ARMV7M_D0 ... ARMV7M_D15:
+			buf_set_u32(r->value + 4, 0, 32, r_vals[idx + 1]);
+			break;
+		}
+
+		buf_set_u32(r->value, 0, 32, value);
+		r->valid = true;
+		r->dirty = false;
+	}
+
+	return ERROR_OK;
+
+flush:
+	/* the queued reads target the local buffers, complete them first */
+	dap_run(armv7m->debug_ap->dap);
+	return retval;
+}
+
+/* The GDB register list is a view of the core cache, so filling the
+ * cache is all that is needed here. */
+static int cortex_m_get_registers_bulk(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	return cortex_m_fast_read_all_regs(target);
+}
+
 static int cortexm_dap_write_coreregister_u32(struct target *target,
 	uint32_t value, int regnum)
 {
@@ -498,6 +679,10 @@ static int cortex_m_debug_entry(struct target *target)
 	 * First load register accessible through core debug port */
 	int num_regs = arm->core_cache->num_regs;
 
+	retval = cortex_m_fast_read_all_regs(target);
+	if (retval != ERROR_OK)
+		LOG_DEBUG("fast register read failed (%d), reading one by one", retval);
+
 	for (i = 0; i < num_regs; i++) {
 		r = &armv7m->arm.core_cache->reg_list[i];
 		if (!r->valid)
@@ -1381,15 +1566,189 @@ int cortex_m_add_breakpoint(struct target *target, struct breakpoint *breakpoint
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 	}
 
+	/* set by cortex_m_flush_breakpoints() */
+	if (breakpoint->type == BKPT_SOFT && target->breakpoint_batch)
+		return ERROR_OK;
+
 	return cortex_m_set_breakpoint(target, breakpoint);
 }
 
+struct cortex_m_bkpt_restore {
+	uint32_t address;
+	uint8_t orig_instr[2];
+};
+
 int cortex_m_remove_breakpoint(struct target *target, struct breakpoint *breakpoint)
 {
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+
 	if (!breakpoint->set)
 		return ERROR_OK;
 
-	return cortex_m_unset_breakpoint(target, breakpoint);
+	if (breakpoint->type != BKPT_SOFT || !target->breakpoint_batch)
+		return cortex_m_unset_breakpoint(target, breakpoint);
+
+	/* the breakpoint is freed on return, keep what has to be restored */
+	if (cortex_m->bkpt_restore_count == cortex_m->bkpt_restore_size) {
+		unsigned int size = cortex_m->bkpt_restore_size ? 2 * cortex_m->bkpt_restore_size : 16;
+		struct cortex_m_bkpt_restore *restore = realloc(cortex_m->bkpt_restore,
+				size * sizeof(*restore));
+		if (!restore)
+			return cortex_m_unset_breakpoint(target, breakpoint);
+		cortex_m->bkpt_restore = restore;
+		cortex_m->bkpt_restore_size = size;
+	}
+
+	struct cortex_m_bkpt_restore *restore = &cortex_m->bkpt_restore[cortex_m->bkpt_restore_count++];
+	restore->address = breakpoint->address & 0xFFFFFFFE;
+	memcpy(restore->orig_instr, breakpoint->orig_instr, 2);
+	breakpoint->set = false;
+
+	return ERROR_OK;
+}
+
+static int cortex_m_word_compare(const void *a, const void *b)
+{
+	uint32_t wa = *(const uint32_t *)a;
+	uint32_t wb = *(const uint32_t *)b;
+
+	return (wa > wb) - (wa < wb);
+}
+
+/* patch the halfword at address into a word read from address & ~3 */
+static uint32_t cortex_m_patch_halfword(uint32_t *words, uint32_t *values,
+		unsigned int num_words, uint32_t address, uint16_t halfword)
+{
+	uint32_t word = address & ~3;
+	uint32_t *w = bsearch(&word, words, num_words, sizeof(*words), cortex_m_word_compare);
+	uint32_t *value = &values[w - words];
+	unsigned int shift = (address & 2) * 8;
+	uint16_t old = *value >> shift;
+
+	*value = (*value & ~(0xffffu << shift)) | ((uint32_t)halfword << shift);
+	return old;
+}
+
+/* write back the instructions of removed breakpoints one at a time */
+static int cortex_m_write_bkpt_restores(struct target *target)
+{
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	int retval = ERROR_OK;
+
+	for (unsigned int i = 0; i < cortex_m->bkpt_restore_count; i++) {
+		int ret = target_write_memory(target, cortex_m->bkpt_restore[i].address,
+				2, 1, cortex_m->bkpt_restore[i].orig_instr);
+		if (ret != ERROR_OK && retval == ERROR_OK)
+			retval = ret;
+	}
+	cortex_m->bkpt_restore_count = 0;
+	return retval;
+}
+
+/*
+ * Apply the software breakpoint changes of a breakpoint batch: restore the
+ * original instructions of removed breakpoints and insert BKPT for the new
+ * ones. All affected words are fetched with one queued read and written
+ * back with one queued write, instead of a read and a write round trip for
+ * every breakpoint.
+ */
+static int cortex_m_flush_breakpoints(struct target *target)
+{
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct cortex_m_common *cortex_m = target_to_cm(target);
+	struct breakpoint *breakpoint;
+	unsigned int n = cortex_m->bkpt_restore_count;
+	unsigned int num_words = 0;
+	uint32_t *words = NULL;
+	uint32_t *values = NULL;
+	uint8_t code[4];
+	int retval = ERROR_OK;
+
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+		if (breakpoint->type == BKPT_SOFT && !breakpoint->set)
+			n++;
+	}
+	if (n == 0)
+		return ERROR_OK;
+
+	/* resuming sets the remaining breakpoints one by one */
+	if (!armv7m->debug_ap)
+		return cortex_m_write_bkpt_restores(target);
+
+	words = malloc(n * sizeof(*words));
+	values = malloc(n * sizeof(*values));
+	if (!words || !values) {
+		LOG_ERROR("Out of memory");
+		retval = ERROR_FAIL;
+		goto done;
+	}
+
+	for (unsigned int i = 0; i < cortex_m->bkpt_restore_count; i++)
+		words[num_words++] = cortex_m->bkpt_restore[i].address & ~3;
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+		if (breakpoint->type == BKPT_SOFT && !breakpoint->set)
+			words[num_words++] = breakpoint->address & ~3;
+	}
+
+	qsort(words, num_words, sizeof(*words), cortex_m_word_compare);
+	n = num_words;
+	num_words = 0;
+	for (unsigned int i = 0; i < n; i++) {
+		if (num_words == 0 || words[num_words - 1] != words[i])
+			words[num_words++] = words[i];
+	}
+
+	for (unsigned int i = 0; i < num_words; i++) {
+		retval = mem_ap_read_u32(armv7m->debug_ap, words[i], &values[i]);
+		if (retval != ERROR_OK)
+			goto done;
+	}
+	retval = dap_run(armv7m->debug_ap->dap);
+	if (retval != ERROR_OK)
+		goto done;
+
+	/* restores first, a breakpoint may be re-inserted at the same address */
+	for (unsigned int i = 0; i < cortex_m->bkpt_restore_count; i++)
+		cortex_m_patch_halfword(words, values, num_words, cortex_m->bkpt_restore[i].address,
+				le_to_h_u16(cortex_m->bkpt_restore[i].orig_instr));
+
+	/* see cortex_m_set_breakpoint() for the choice of BKPT parameter */
+	buf_set_u32(code, 0, 32, ARMV5_T_BKPT(0x11));
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+		if (breakpoint->type != BKPT_SOFT || breakpoint->set)
+			continue;
+		uint16_t orig = cortex_m_patch_halfword(words, values, num_words,
+				breakpoint->address & 0xFFFFFFFE, le_to_h_u16(code));
+		h_u16_to_le(breakpoint->orig_instr, orig);
+	}
+
+	for (unsigned int i = 0; i < num_words; i++) {
+		retval = mem_ap_write_u32(armv7m->debug_ap, words[i], values[i]);
+		if (retval != ERROR_OK)
+			goto done;
+	}
+	retval = dap_run(armv7m->debug_ap->dap);
+	if (retval != ERROR_OK)
+		goto done;
+
+	for (breakpoint = target->breakpoints; breakpoint; breakpoint = breakpoint->next) {
+		if (breakpoint->type == BKPT_SOFT && !breakpoint->set) {
+			breakpoint->set = true;
+			LOG_DEBUG("BPID: %" PRIu32 ", Address: " TARGET_ADDR_FMT " set",
+				breakpoint->unique_id, breakpoint->address);
+		}
+	}
+
+done:
+	free(words);
+	free(values);
+	if (retval != ERROR_OK) {
+		/* don't lose the original instructions of removed breakpoints */
+		cortex_m_write_bkpt_restores(target);
+		return retval;
+	}
+	cortex_m->bkpt_restore_count = 0;
+	return ERROR_OK;
 }
 
 int cortex_m_set_watchpoint(struct target *target, struct watchpoint *watchpoint)
@@ -1612,10 +1971,7 @@ static int cortex_m_load_core_reg_u32(struct target *target,
 
 		case ARMV7M_FPSCR:
 			/* Floating-point Status and Registers */
-			retval = target_write_u32(target, DCB_DCRSR, 0x21);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = target_read_u32(target, DCB_DCRDR, value);
+			retval = cortexm_dap_read_coreregister_u32(target, value, 0x21);
 			if (retval != ERROR_OK)
 				return retval;
 			LOG_DEBUG("load from FPSCR  value 0x%" PRIx32, *value);
@@ -1623,10 +1979,8 @@ static int cortex_m_load_core_reg_u32(struct target *target,
 
 		case ARMV7M_S0 ... ARMV7M_S31:
 			/* Floating-point Status and Registers */
-			retval = target_write_u32(target, DCB_DCRSR, num - ARMV7M_S0 + 0x40);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = target_read_u32(target, DCB_DCRDR, value);
+			retval = cortexm_dap_read_coreregister_u32(target, value,
+					num - ARMV7M_S0 + 0x40);
 			if (retval != ERROR_OK)
 				return retval;
 			LOG_DEBUG("load from FPU reg S%d  value 0x%" PRIx32,
@@ -1698,10 +2052,7 @@ static int cortex_m_store_core_reg_u32(struct target *target,
 
 		case ARMV7M_FPSCR:
 			/* Floating-point Status and Registers */
-			retval = target_write_u32(target, DCB_DCRDR, value);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = target_write_u32(target, DCB_DCRSR, 0x21 | (1<<16));
+			retval = cortexm_dap_write_coreregister_u32(target, value, 0x21);
 			if (retval != ERROR_OK)
 				return retval;
 			LOG_DEBUG("write FPSCR value 0x%" PRIx32, value);
@@ -1709,10 +2060,8 @@ static int cortex_m_store_core_reg_u32(struct target *target,
 
 		case ARMV7M_S0 ... ARMV7M_S31:
 			/* Floating-point Status and Registers */
-			retval = target_write_u32(target, DCB_DCRDR, value);
-			if (retval != ERROR_OK)
-				return retval;
-			retval = target_write_u32(target, DCB_DCRSR, (num - ARMV7M_S0 + 0x40) | (1<<16));
+			retval = cortexm_dap_write_coreregister_u32(target, value,
+					num - ARMV7M_S0 + 0x40);
 			if (retval != ERROR_OK)
 				return retval;
 			LOG_DEBUG("write FPU reg S%d  value 0x%" PRIx32,
@@ -1800,6 +2149,7 @@ void cortex_m_deinit_target(struct target *target)
 	struct cortex_m_common *cortex_m = target_to_cm(target);
 
 	free(cortex_m->fp_comparator_list);
+	free(cortex_m->bkpt_restore);
 
 	cortex_m_dwt_free(target);
 	armv7m_free_reg_cache(target);
@@ -2675,6 +3025,7 @@ struct target_type cortexm_target = {
 
 	.get_gdb_arch = arm_get_gdb_arch,
 	.get_gdb_reg_list = armv7m_get_gdb_reg_list,
+	.get_registers_bulk = cortex_m_get_registers_bulk,
 
 	.read_memory = cortex_m_read_memory,
 	.write_memory = cortex_m_write_memory,
@@ -2687,6 +3038,7 @@ struct target_type cortexm_target = {
 
 	.add_breakpoint = cortex_m_add_breakpoint,
 	.remove_breakpoint = cortex_m_remove_breakpoint,
+	.flush_breakpoints = cortex_m_flush_breakpoints,
 	.add_watchpoint = cortex_m_add_watchpoint,
 	.remove_watchpoint = cortex_m_remove_watchpoint,
 
@@ -191,6 +191,11 @@ struct cortex_m_common {
 	bool fpb_enabled;
 	struct cortex_m_fp_comparator *fp_comparator_list;
 
+	/* software breakpoints removed while a breakpoint batch is open */
+	struct cortex_m_bkpt_restore *bkpt_restore;
+	unsigned int bkpt_restore_count;
+	unsigned int bkpt_restore_size;
+
 	/* Data Watchpoint and Trace (DWT) */
 	int dwt_num_comp;
 	int dwt_comp_available;
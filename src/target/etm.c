@@ -648,27 +648,154 @@ static struct etm_capture_driver *etm_capture_drivers[] = {
 	NULL
 };
 
-static int etm_read_instruction(struct etm_context *ctx, struct arm_instruction *instruction)
+/*
+ * Trace analysis decodes the same loop bodies over and over, so keep the
+ * image sections sorted for lookup and remember recently decoded opcodes
+ * in a direct-mapped table keyed by address and core state.
+ */
+#define ETM_DECODE_CACHE_BITS	12
+#define ETM_DECODE_CACHE_SIZE	(1 << ETM_DECODE_CACHE_BITS)
+
+struct etm_decode_entry {
+	bool valid;
+	int /*arm_state*/ core_state;
+	uint32_t address;
+	struct arm_instruction instruction;
+};
+
+struct etm_section_range {
+	target_addr_t start;
+	target_addr_t end;
+	int section;
+};
+
+struct etm_decode_cache {
+	struct etm_section_range *ranges;
+	int num_ranges;
+	struct etm_decode_entry entries[ETM_DECODE_CACHE_SIZE];
+};
+
+static void etm_decode_cache_free(struct etm_context *ctx)
 {
-	int i;
-	int section = -1;
+	if (!ctx->decode_cache)
+		return;
+
+	free(ctx->decode_cache->ranges);
+	free(ctx->decode_cache);
+	ctx->decode_cache = NULL;
+}
+
+static int etm_section_range_compare(const void *a, const void *b)
+{
+	const struct etm_section_range *ra = a;
+	const struct etm_section_range *rb = b;
+
+	if (ra->start != rb->start)
+		return (ra->start < rb->start) ? -1 : 1;
+	/* keep image order for sections starting at the same address */
+	return ra->section - rb->section;
+}
+
+static struct etm_decode_cache *etm_decode_cache_get(struct etm_context *ctx)
+{
+	struct etm_decode_cache *cache = ctx->decode_cache;
+
+	if (cache)
+		return cache;
+
+	cache = calloc(1, sizeof(*cache));
+	if (!cache)
+		return NULL;
+
+	cache->ranges = calloc(ctx->image->num_sections + 1, sizeof(*cache->ranges));
+	if (!cache->ranges) {
+		free(cache);
+		return NULL;
+	}
+
+	for (int i = 0; i < ctx->image->num_sections; i++) {
+		struct imagesection *section = &ctx->image->sections[i];
+
+		if (section->size == 0)
+			continue;
+		cache->ranges[cache->num_ranges].start = section->base_address;
+		cache->ranges[cache->num_ranges].end = section->base_address + section->size;
+		cache->ranges[cache->num_ranges].section = i;
+		cache->num_ranges++;
+	}
+	qsort(cache->ranges, cache->num_ranges, sizeof(*cache->ranges),
+			etm_section_range_compare);
+
+	ctx->decode_cache = cache;
+	return cache;
+}
+
+/* returns the image section containing address, or -1 */
+static int etm_find_section(struct etm_decode_cache *cache, uint32_t address)
+{
+	int lo = 0;
+	int hi = cache->num_ranges;
+
+	/* find the first range starting above address ... */
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (cache->ranges[mid].start <= address)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	/* ... and check the ranges before it, which may overlap */
+	for (int i = lo - 1; i >= 0; i--) {
+		if (cache->ranges[i].end > address)
+			return cache->ranges[i].section;
+	}
+
+	return -1;
+}
+
+static int etm_read_opcode(struct etm_context *ctx, int section,
+		uint32_t size, uint8_t *buf)
+{
+	uint32_t offset = ctx->current_pc - ctx->image->sections[section].base_address;
+	const uint8_t *data;
 	size_t size_read;
+
+	if (image_section_data(ctx->image, section, offset, size, &data) == ERROR_OK) {
+		memcpy(buf, data, size);
+		return ERROR_OK;
+	}
+
+	return image_read_section(ctx->image, section, offset, size, buf, &size_read);
+}
+
+static int etm_read_instruction(struct etm_context *ctx, struct arm_instruction *instruction)
+{
+	struct etm_decode_cache *cache;
+	struct etm_decode_entry *entry;
+	int section;
 	uint32_t opcode;
+	uint32_t pc = ctx->current_pc;
 	int retval;
 
 	if (!ctx->image)
 		return ERROR_TRACE_IMAGE_UNAVAILABLE;
 
-	/* search for the section the current instruction belongs to */
-	for (i = 0; i < ctx->image->num_sections; i++) {
-		if ((ctx->image->sections[i].base_address <= ctx->current_pc) &&
-			(ctx->image->sections[i].base_address + ctx->image->sections[i].size >
-			ctx->current_pc)) {
-			section = i;
-			break;
-		}
+	cache = etm_decode_cache_get(ctx);
+	if (!cache) {
+		LOG_ERROR("Out of memory");
+		return ERROR_FAIL;
 	}
 
+	entry = &cache->entries[((pc >> 1) ^ (pc >> (ETM_DECODE_CACHE_BITS + 1)))
+			& (ETM_DECODE_CACHE_SIZE - 1)];
+	if (entry->valid && entry->address == pc && entry->core_state == ctx->core_state) {
+		*instruction = entry->instruction;
+		return ERROR_OK;
+	}
+
+	/* search for the section the current instruction belongs to */
+	section = etm_find_section(cache, pc);
 	if (section == -1) {
 		/* current instruction couldn't be found in the image */
 		return ERROR_TRACE_INSTRUCTION_UNAVAILABLE;
@@ -676,28 +803,22 @@ static int etm_read_instruction(struct etm_context *ctx, struct arm_instruction
 
 	if (ctx->core_state == ARM_STATE_ARM) {
 		uint8_t buf[4];
-		retval = image_read_section(ctx->image, section,
-				ctx->current_pc -
-				ctx->image->sections[section].base_address,
-				4, buf, &size_read);
+		retval = etm_read_opcode(ctx, section, 4, buf);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("error while reading instruction");
 			return ERROR_TRACE_INSTRUCTION_UNAVAILABLE;
 		}
 		opcode = target_buffer_get_u32(ctx->target, buf);
-		arm_evaluate_opcode(opcode, ctx->current_pc, instruction);
+		arm_evaluate_opcode(opcode, pc, instruction);
 	} else if (ctx->core_state == ARM_STATE_THUMB) {
 		uint8_t buf[2];
-		retval = image_read_section(ctx->image, section,
-				ctx->current_pc -
-				ctx->image->sections[section].base_address,
-				2, buf, &size_read);
+		retval = etm_read_opcode(ctx, section, 2, buf);
 		if (retval != ERROR_OK) {
 			LOG_ERROR("error while reading instruction");
 			return ERROR_TRACE_INSTRUCTION_UNAVAILABLE;
 		}
 		opcode = target_buffer_get_u16(ctx->target, buf);
-		thumb_evaluate_opcode(opcode, ctx->current_pc, instruction);
+		thumb_evaluate_opcode(opcode, pc, instruction);
 	} else if (ctx->core_state == ARM_STATE_JAZELLE) {
 		LOG_ERROR("BUG: tracing of jazelle code not supported");
 		return ERROR_FAIL;
@@ -706,6 +827,11 @@ static int etm_read_instruction(struct etm_context *ctx, struct arm_instruction
 		return ERROR_FAIL;
 	}
 
+	entry->valid = true;
+	entry->address = pc;
+	entry->core_state = ctx->core_state;
+	entry->instruction = *instruction;
+
 	return ERROR_OK;
 }
 
@@ -1676,6 +1802,7 @@ COMMAND_HANDLER(handle_etm_image_command)
 		return ERROR_FAIL;
 	}
 
+	etm_decode_cache_free(etm_ctx);
 	if (etm_ctx->image) {
 		image_close(etm_ctx->image);
 		free(etm_ctx->image);
@@ -132,6 +132,7 @@ enum {
 
 /* forward-declare ETM context */
 struct etm_context;
+struct etm_decode_cache;
 
 struct etm_capture_driver {
 	const char *name;
@@ -170,6 +171,7 @@ struct etm_context {
 	uint32_t control;	/* shadow of ETM_CTRL */
 	int /*arm_state*/ core_state;	/* current core state */
 	struct image *image;		/* source for target opcodes */
+	struct etm_decode_cache *decode_cache;	/* decoded opcodes from image */
 	uint32_t pipe_index;		/* current trace cycle */
 	uint32_t data_index;		/* cycle holding next data packet */
 	bool data_half;			/* port half on a 16 bit port */
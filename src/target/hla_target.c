@@ -384,11 +384,42 @@ static int adapter_target_create(struct target *target,
 	return ERROR_OK;
 }
 
+/* Fill the core registers the adapter can return in one transaction */
+static int adapter_load_core_regs_bulk(struct target *target)
+{
+	struct hl_interface_s *adapter = target_to_adapter(target);
+	struct armv7m_common *armv7m = target_to_armv7m(target);
+	struct reg_cache *cache = armv7m->arm.core_cache;
+	uint32_t regs[HL_NUM_BULK_REGS];
+
+	int retval = adapter->layout->api->read_regs(adapter->handle, regs);
+	if (retval != ERROR_OK)
+		return retval;
+
+	for (unsigned int i = 0; i < cache->num_regs; i++) {
+		struct reg *r = &cache->reg_list[i];
+		struct arm_reg *arm_reg = r->arch_info;
+
+		if (r->valid || arm_reg->num >= HL_NUM_BULK_REGS)
+			continue;
+
+		buf_set_u32(r->value, 0, 32, regs[arm_reg->num]);
+		r->valid = true;
+		r->dirty = false;
+	}
+
+	return ERROR_OK;
+}
+
 static int adapter_load_context(struct target *target)
 {
 	struct armv7m_common *armv7m = target_to_armv7m(target);
 	int num_regs = armv7m->arm.core_cache->num_regs;
 
+	/* on failure, the loop below reads the registers one by one */
+	if (adapter_load_core_regs_bulk(target) != ERROR_OK)
+		LOG_DEBUG("bulk register read not available");
+
 	for (int i = 0; i < num_regs; i++) {
 
 		struct reg *r = &armv7m->arm.core_cache->reg_list[i];
@@ -32,6 +32,7 @@
 #include "image.h"
 #include "target.h"
 #include <helper/log.h>
+#include <helper/binarybuffer.h>
 
 /* convert ELF header field to host endianness */
 #define field16(elf, field) \
@@ -191,16 +192,17 @@ static int image_ihex_buffer_complete_inner(struct image *image,
 					full_address = (full_address & 0xffff0000) | address;
 				}
 
-				while (count-- > 0) {
-					unsigned value;
-					sscanf(&lpszLine[bytes_read], "%2x", &value);
-					ihex->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)ihex->buffer[cooked_bytes];
-					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
-				}
+				/* decode the whole payload at once */
+				if (unhexify(&ihex->buffer[cooked_bytes], &lpszLine[bytes_read], count)
+						!= count)
+					return ERROR_IMAGE_FORMAT_ERROR;
+
+				for (i = 0; i < (int)count; i++)
+					cal_checksum += ihex->buffer[cooked_bytes + i];
+				bytes_read += 2 * count;
+				cooked_bytes += count;
+				section[image->num_sections].size += count;
+				full_address += count;
 			} else if (record_type == 1) {	/* End of File Record */
 				/* finish the current section */
 				image->num_sections++;
@@ -633,16 +635,18 @@ static int image_mot_buffer_complete_inner(struct image *image,
 					full_address = address;
 				}
 
-				while (count-- > 0) {
-					unsigned value;
-					sscanf(&lpszLine[bytes_read], "%2x", &value);
-					mot->buffer[cooked_bytes] = (uint8_t)value;
-					cal_checksum += (uint8_t)mot->buffer[cooked_bytes];
-					bytes_read += 2;
-					cooked_bytes += 1;
-					section[image->num_sections].size += 1;
-					full_address++;
-				}
+				/* decode the whole payload at once; a record too short
+				 * for its address field has wrapped count around */
+				if (count > 0xff || unhexify(&mot->buffer[cooked_bytes],
+						&lpszLine[bytes_read], count) != count)
+					return ERROR_IMAGE_FORMAT_ERROR;
+
+				for (i = 0; i < (int)count; i++)
+					cal_checksum += mot->buffer[cooked_bytes + i];
+				bytes_read += 2 * count;
+				cooked_bytes += count;
+				section[image->num_sections].size += count;
+				full_address += count;
 			} else if (record_type == 5 || record_type == 6) {
 				/* S5 and S6 are the data count records, we ignore them */
 				uint32_t dummy;
@@ -936,6 +940,91 @@ int image_read_section(struct image *image,
 	return ERROR_OK;
 }
 
+/**
+ * Gives direct access to section contents without copying them: plain
+ * binary and ELF files are mapped, decoded text formats are already held
+ * in memory.  The data stays valid until image_close().
+ * @returns ERROR_OK, or an error if direct access isn't possible (target
+ * memory images, unmapped files, ELF ranges beyond the file contents),
+ * in which case image_read_section() must be used instead.
+ */
+int image_section_data(struct image *image, int section, uint32_t offset,
+		uint32_t size, const uint8_t **data)
+{
+	const uint8_t *map;
+	size_t file_size;
+
+	if (offset + size > image->sections[section].size)
+		return ERROR_COMMAND_SYNTAX_ERROR;
+
+	switch (image->type) {
+		case IMAGE_BINARY: {
+			struct image_binary *image_binary = image->type_private;
+
+			if (fileio_map(image_binary->fileio, &map) != ERROR_OK)
+				return ERROR_FAIL;
+			*data = map + offset;
+			return ERROR_OK;
+		}
+		case IMAGE_ELF: {
+			struct image_elf *elf = image->type_private;
+			Elf32_Phdr *segment = (Elf32_Phdr *)image->sections[section].private;
+			uint32_t file_offset = field32(elf, segment->p_offset) + offset;
+
+			if (offset + size > field32(elf, segment->p_filesz))
+				return ERROR_FAIL;
+			if (fileio_size(elf->fileio, &file_size) != ERROR_OK ||
+					file_offset + (size_t)size > file_size)
+				return ERROR_FAIL;
+			if (fileio_map(elf->fileio, &map) != ERROR_OK)
+				return ERROR_FAIL;
+			*data = map + file_offset;
+			return ERROR_OK;
+		}
+		case IMAGE_IHEX:
+		case IMAGE_SRECORD:
+		case IMAGE_BUILDER:
+			*data = (const uint8_t *)image->sections[section].private + offset;
+			return ERROR_OK;
+		default:
+			return ERROR_FAIL;
+	}
+}
+
+/**
+ * Gets the contents of a whole section, without copying where the image
+ * type allows it.  If a buffer had to be allocated it is returned in
+ * @a alloc and must be freed by the caller; otherwise @a alloc is NULL.
+ */
+int image_section_get(struct image *image, int section,
+		const uint8_t **data, uint8_t **alloc, size_t *size)
+{
+	uint32_t section_size = image->sections[section].size;
+
+	*alloc = NULL;
+	if (image_section_data(image, section, 0, section_size, data) == ERROR_OK) {
+		*size = section_size;
+		return ERROR_OK;
+	}
+
+	*alloc = malloc(section_size);
+	if (*alloc == NULL) {
+		LOG_ERROR("error allocating buffer for section (%" PRIu32 " bytes)",
+				section_size);
+		return ERROR_FAIL;
+	}
+
+	int retval = image_read_section(image, section, 0, section_size, *alloc, size);
+	if (retval != ERROR_OK) {
+		free(*alloc);
+		*alloc = NULL;
+		return retval;
+	}
+
+	*data = *alloc;
+	return ERROR_OK;
+}
+
 int image_add_section(struct image *image, uint32_t base, uint32_t size, int flags, uint8_t const *data)
 {
 	struct imagesection *section;
@@ -1038,7 +1127,7 @@ void image_close(struct image *image)
 	}
 }
 
-int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes, uint32_t *checksum)
+int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes, uint32_t *checksum)
 {
 	uint32_t crc = 0xffffffff;
 	LOG_DEBUG("Calculating checksum");
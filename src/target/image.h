@@ -94,12 +94,16 @@ struct image_mot {
 int image_open(struct image *image, const char *url, const char *type_string);
 int image_read_section(struct image *image, int section, uint32_t offset,
 		uint32_t size, uint8_t *buffer, size_t *size_read);
+int image_section_data(struct image *image, int section, uint32_t offset,
+		uint32_t size, const uint8_t **data);
+int image_section_get(struct image *image, int section,
+		const uint8_t **data, uint8_t **alloc, size_t *size);
 void image_close(struct image *image);
 
 int image_add_section(struct image *image, uint32_t base, uint32_t size,
 		int flags, uint8_t const *data);
 
-int image_calculate_checksum(uint8_t *buffer, uint32_t nbytes,
+int image_calculate_checksum(const uint8_t *buffer, uint32_t nbytes,
 		uint32_t *checksum);
 
 #define ERROR_IMAGE_FORMAT_ERROR	(-1400)
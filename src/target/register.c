@@ -36,6 +36,144 @@
  * may be separate registers associated with debug or trace modules.
  */
 
+/* Caches with at least this many registers (e.g. RISC-V with its CSRs)
+ * get a hash index by name and by number, built on first lookup. */
+#define REG_CACHE_INDEX_MIN_REGS	64
+
+struct reg_cache_index {
+	const struct reg_cache *cache;
+	/* cache layout the index was built for */
+	const struct reg *reg_list;
+	unsigned num_regs;
+
+	unsigned mask;
+	/* bucket heads and per register chains of reg_list indexes, -1 ends;
+	 * chains are in ascending index order like the linear search */
+	int *name_head;
+	int *name_next;
+	int *number_head;
+	int *number_next;
+
+	struct reg_cache_index *next;
+};
+
+static struct reg_cache_index *reg_cache_indexes;
+
+static unsigned register_name_hash(const char *name)
+{
+	unsigned hash = 2166136261u;
+
+	while (*name) {
+		hash ^= (unsigned char)*name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static unsigned register_number_hash(uint32_t number)
+{
+	return number * 2654435761u;
+}
+
+static void register_cache_index_release(struct reg_cache_index *index)
+{
+	free(index->name_head);
+	free(index->name_next);
+	free(index->number_head);
+	free(index->number_next);
+	free(index);
+}
+
+static struct reg_cache_index *register_cache_index_build(const struct reg_cache *cache)
+{
+	struct reg_cache_index *index = calloc(1, sizeof(*index));
+	if (!index)
+		return NULL;
+
+	unsigned buckets = 1;
+	while (buckets < cache->num_regs)
+		buckets <<= 1;
+
+	index->cache = cache;
+	index->reg_list = cache->reg_list;
+	index->num_regs = cache->num_regs;
+	index->mask = buckets - 1;
+	index->name_head = malloc(buckets * sizeof(int));
+	index->number_head = malloc(buckets * sizeof(int));
+	index->name_next = malloc(cache->num_regs * sizeof(int));
+	index->number_next = malloc(cache->num_regs * sizeof(int));
+	if (!index->name_head || !index->number_head ||
+			!index->name_next || !index->number_next) {
+		register_cache_index_release(index);
+		return NULL;
+	}
+
+	memset(index->name_head, 0xff, buckets * sizeof(int));
+	memset(index->number_head, 0xff, buckets * sizeof(int));
+
+	/* push in reverse so every chain ends up in ascending order */
+	for (int i = cache->num_regs - 1; i >= 0; i--) {
+		const struct reg *reg = &cache->reg_list[i];
+		unsigned b;
+
+		index->name_next[i] = -1;
+		if (reg->name) {
+			b = register_name_hash(reg->name) & index->mask;
+			index->name_next[i] = index->name_head[b];
+			index->name_head[b] = i;
+		}
+
+		b = register_number_hash(reg->number) & index->mask;
+		index->number_next[i] = index->number_head[b];
+		index->number_head[b] = i;
+	}
+
+	return index;
+}
+
+static struct reg_cache_index *register_cache_index_get(const struct reg_cache *cache)
+{
+	if (cache->num_regs < REG_CACHE_INDEX_MIN_REGS || !cache->reg_list)
+		return NULL;
+
+	struct reg_cache_index **p = &reg_cache_indexes;
+	for (; *p; p = &(*p)->next) {
+		if ((*p)->cache != cache)
+			continue;
+		if ((*p)->reg_list == cache->reg_list && (*p)->num_regs == cache->num_regs)
+			return *p;
+
+		/* the cache was resized or reallocated, rebuild */
+		struct reg_cache_index *stale = *p;
+		*p = stale->next;
+		register_cache_index_release(stale);
+		break;
+	}
+
+	struct reg_cache_index *index = register_cache_index_build(cache);
+	if (index) {
+		index->next = reg_cache_indexes;
+		reg_cache_indexes = index;
+	}
+	return index;
+}
+
+/**
+ * Drops the lookup index of a cache.  Must be called before a cache is
+ * freed, or after its register names or numbers have been changed.
+ */
+void register_cache_index_free(const struct reg_cache *cache)
+{
+	for (struct reg_cache_index **p = &reg_cache_indexes; *p; p = &(*p)->next) {
+		if ((*p)->cache == cache) {
+			struct reg_cache_index *index = *p;
+			*p = index->next;
+			register_cache_index_release(index);
+			return;
+		}
+	}
+}
+
 struct reg *register_get_by_number(struct reg_cache *first,
 		uint32_t reg_num, bool search_all)
 {
@@ -43,6 +181,17 @@ struct reg *register_get_by_number(struct reg_cache *first,
 	struct reg_cache *cache = first;
 
 	while (cache) {
+		struct reg_cache_index *index = register_cache_index_get(cache);
+		if (index) {
+			int n = index->number_head[register_number_hash(reg_num) & index->mask];
+			for (; n >= 0; n = index->number_next[n]) {
+				struct reg *reg = &cache->reg_list[n];
+				if (reg->exist && reg->number == reg_num)
+					return reg;
+			}
+			goto next_cache;
+		}
+
 		for (i = 0; i < cache->num_regs; i++) {
 			if (cache->reg_list[i].exist == false)
 				continue;
@@ -50,6 +199,7 @@ struct reg *register_get_by_number(struct reg_cache *first,
 				return &(cache->reg_list[i]);
 		}
 
+next_cache:
 		if (search_all)
 			cache = cache->next;
 		else
@@ -66,6 +216,17 @@ struct reg *register_get_by_name(struct reg_cache *first,
 	struct reg_cache *cache = first;
 
 	while (cache) {
+		struct reg_cache_index *index = register_cache_index_get(cache);
+		if (index) {
+			int n = index->name_head[register_name_hash(name) & index->mask];
+			for (; n >= 0; n = index->name_next[n]) {
+				struct reg *reg = &cache->reg_list[n];
+				if (reg->exist && strcmp(reg->name, name) == 0)
+					return reg;
+			}
+			goto next_cache;
+		}
+
 		for (i = 0; i < cache->num_regs; i++) {
 			if (cache->reg_list[i].exist == false)
 				continue;
@@ -73,6 +234,7 @@ struct reg *register_get_by_name(struct reg_cache *first,
 				return &(cache->reg_list[i]);
 		}
 
+next_cache:
 		if (search_all)
 			cache = cache->next;
 		else
@@ -101,6 +263,8 @@ void register_unlink_cache(struct reg_cache **cache_p, const struct reg_cache *c
 		cache_p = &((*cache_p)->next);
 	if (*cache_p)
 		*cache_p = cache->next;
+
+	register_cache_index_free(cache);
 }
 
 /** Marks the contents of the register cache as invalid (and clean). */
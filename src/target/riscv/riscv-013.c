@@ -38,9 +38,14 @@ static void riscv013_clear_abstract_error(struct target *target);
 static int riscv013_get_register(struct target *target,
 		riscv_reg_t *value, int hid, int rid);
 static int riscv013_set_register(struct target *target, int hartid, int regid, uint64_t value);
+static int riscv013_get_gprs_bulk(struct target *target, riscv_reg_t *values);
 static int riscv013_select_current_hart(struct target *target);
 static int riscv013_halt_current_hart(struct target *target);
 static int riscv013_resume_current_hart(struct target *target);
+static int riscv013_halt_harts(struct target *target, uint64_t hart_mask);
+static int riscv013_resume_harts(struct target *target, uint64_t hart_mask);
+static int riscv013_harts_halted(struct target *target, uint64_t hart_mask,
+		bool *any_halted, bool *all_halted);
 static int riscv013_step_current_hart(struct target *target);
 static int riscv013_on_halt(struct target *target);
 static int riscv013_on_step(struct target *target);
@@ -143,6 +148,15 @@ typedef enum {
 	YNM_NO
 } yes_no_maybe_t;
 
+/* Number of hart array windows covering the harts of a hart_mask. */
+#define HAWINDOW_COUNT		2
+
+typedef enum {
+	MEM_METHOD_PROGBUF,
+	MEM_METHOD_SBA,
+	MEM_METHOD_COUNT
+} mem_method_t;
+
 typedef struct {
 	struct list_head list;
 	int abs_chain_position;
@@ -152,6 +166,11 @@ typedef struct {
 	struct list_head target_list;
 	/* The currently selected hartid on this DM. */
 	int current_hartid;
+	/* Whether the DM implements the hart array mask (hasel/hawindow). */
+	yes_no_maybe_t hasel_supported;
+	/* Last value written to each hart array window, valid if hawindow_valid. */
+	uint32_t hawindow[HAWINDOW_COUNT];
+	bool hawindow_valid;
 } dm013_info_t;
 
 typedef struct {
@@ -187,6 +206,15 @@ typedef struct {
 	 * reads/writes respectively. */
 	unsigned int bus_master_write_delay, bus_master_read_delay;
 
+	/* Measured throughput in bytes/ms of bulk reads and writes through each
+	 * memory access method, 0 until measured, and the number of bulk
+	 * transfers so far. */
+	unsigned int mem_rate[2][MEM_METHOD_COUNT];
+	unsigned int mem_transfers[2];
+	/* Set once a system bus read or write failed where the program buffer
+	 * could be used instead. */
+	bool sba_failed[2];
+
 	/* This value is increased every time we tried to execute two commands
 	 * consecutively, and the second one failed because the previous hadn't
 	 * completed yet.  It's used to add extra run-test/idle cycles after
@@ -212,6 +240,10 @@ typedef struct {
 	/* The width of the hartsel field. */
 	unsigned hartsellen;
 
+	/* Number of DMI scans issued so far, to account for the cost of an
+	 * operation. */
+	unsigned int dmi_scans;
+
 	/* DM that provides access to this target. */
 	dm013_info_t *dm;
 } riscv013_info_t;
@@ -472,6 +504,8 @@ static dmi_status_t dmi_scan(struct target *target, uint32_t *address_in,
 
 	assert(info->abits != 0);
 
+	info->dmi_scans++;
+
 	buf_set_u32(out, DTM_DMI_OP_OFFSET, DTM_DMI_OP_LENGTH, op);
 	buf_set_u32(out, DTM_DMI_DATA_OFFSET, DTM_DMI_DATA_LENGTH, data_out);
 	buf_set_u32(out, DTM_DMI_ADDRESS_OFFSET, info->abits, address_out);
@@ -1426,6 +1460,17 @@ static int examine(struct target *target)
 	}
 	LOG_DEBUG("hartsellen=%d", info->hartsellen);
 
+	/* Find out whether the hart array mask is implemented, hasel is 0 if
+	 * not. This also leaves hartsel pointing at hart 0. */
+	dmi_write(target, DMI_DMCONTROL, DMI_DMCONTROL_DMACTIVE | DMI_DMCONTROL_HASEL);
+	if (dmi_read(target, &dmcontrol, DMI_DMCONTROL) != ERROR_OK)
+		return ERROR_FAIL;
+	dm->hasel_supported = get_field(dmcontrol, DMI_DMCONTROL_HASEL) ? YNM_YES : YNM_NO;
+	dm->hawindow_valid = false;
+	dmi_write(target, DMI_DMCONTROL, DMI_DMCONTROL_DMACTIVE);
+	dm->current_hartid = 0;
+	LOG_DEBUG("hasel=%d", dm->hasel_supported == YNM_YES);
+
 	uint32_t hartinfo;
 	if (dmi_read(target, &hartinfo, DMI_HARTINFO) != ERROR_OK)
 		return ERROR_FAIL;
@@ -1447,6 +1492,8 @@ static int examine(struct target *target)
 
 	if (dmi_read(target, &info->sbcs, DMI_SBCS) != ERROR_OK)
 		return ERROR_FAIL;
+	info->sba_failed[0] = false;
+	info->sba_failed[1] = false;
 
 	/* Check that abstract data registers are accessible. */
 	uint32_t abstractcs;
@@ -1594,10 +1641,14 @@ static int init_target(struct command_context *cmd_ctx,
 
 	generic_info->get_register = &riscv013_get_register;
 	generic_info->set_register = &riscv013_set_register;
+	generic_info->get_gprs_bulk = &riscv013_get_gprs_bulk;
 	generic_info->select_current_hart = &riscv013_select_current_hart;
 	generic_info->is_halted = &riscv013_is_halted;
 	generic_info->halt_current_hart = &riscv013_halt_current_hart;
 	generic_info->resume_current_hart = &riscv013_resume_current_hart;
+	generic_info->halt_harts = &riscv013_halt_harts;
+	generic_info->resume_harts = &riscv013_resume_harts;
+	generic_info->harts_halted = &riscv013_harts_halted;
 	generic_info->step_current_hart = &riscv013_step_current_hart;
 	generic_info->on_halt = &riscv013_on_halt;
 	generic_info->on_resume = &riscv013_on_resume;
@@ -1913,6 +1964,9 @@ static int sb_write_address(struct target *target, target_addr_t address)
 	return dmi_write(target, DMI_SBADDRESS0, address);
 }
 
+/* Number of scans the system bus access routines queue in one batch. */
+#define SB_BATCH_SCANS		512
+
 static int read_sbcs_nonbusy(struct target *target, uint32_t *sbcs)
 {
 	time_t start = time(NULL);
@@ -2007,8 +2061,57 @@ static int read_memory_bus_v0(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+static int batch_run(const struct target *target, struct riscv_batch *batch)
+{
+	RISCV013_INFO(info);
+	RISCV_INFO(r);
+	if (r->reset_delays_wait >= 0) {
+		r->reset_delays_wait -= batch->used_scans;
+		if (r->reset_delays_wait <= 0) {
+			batch->idle_count = 0;
+			info->dmi_busy_delay = 0;
+			info->ac_busy_delay = 0;
+		}
+	}
+	return riscv_batch_run(batch);
+}
+
+/*
+ * Wait for the system bus to be idle after a batch of accesses. *dmi_busy
+ * tells whether the DTM answered busy, in which case it ignored the rest of
+ * the batch.
+ */
+static int sb_batch_done(struct target *target, uint32_t *sbcs, bool *dmi_busy)
+{
+	if (dmi_op(target, sbcs, dmi_busy, DMI_OP_READ, DMI_SBCS, 0, false) != ERROR_OK)
+		return ERROR_FAIL;
+	if (get_field(*sbcs, DMI_SBCS_SBBUSY))
+		return read_sbcs_nonbusy(target, sbcs);
+	return ERROR_OK;
+}
+
+/* Queue the writes of sb_write_address() into a batch. */
+static void sb_batch_add_address(struct target *target,
+		struct riscv_batch *batch, target_addr_t address)
+{
+	RISCV013_INFO(info);
+	unsigned sbasize = get_field(info->sbcs, DMI_SBCS_SBASIZE);
+	if (sbasize > 96)
+		riscv_batch_add_dmi_write(batch, DMI_SBADDRESS3, 0);
+	if (sbasize > 64)
+		riscv_batch_add_dmi_write(batch, DMI_SBADDRESS2, 0);
+	if (sbasize > 32)
+		riscv_batch_add_dmi_write(batch, DMI_SBADDRESS1, address >> 32);
+	riscv_batch_add_dmi_write(batch, DMI_SBADDRESS0, address);
+}
+
 /**
  * Read the requested memory using the system bus interface.
+ *
+ * The reads are queued in batches, with sbreadondata set so that reading
+ * SBDATA0 starts the next bus access, and sbcs is only checked once per
+ * batch. If a batch fails, the transfer picks up again at the first word
+ * that wasn't read for sure, with longer delays.
  */
 static int read_memory_bus_v1(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, uint8_t *buffer)
@@ -2016,54 +2119,110 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 	RISCV013_INFO(info);
 	target_addr_t next_address = address;
 	target_addr_t end_address = address + count * size;
+	/* Words wider than 32 bits are read through SBDATA3..SBDATA0. */
+	unsigned sbdata_count = (size + 3) / 4;
+	/* A read and its NOP per SBDATA register, and the SBCS write before the
+	 * last word. */
+	unsigned word_scans = 2 * sbdata_count + 1;
+	uint32_t sbcs = set_field(0, DMI_SBCS_SBREADONADDR, 1);
+	sbcs |= sb_sbaccess(size);
+	sbcs = set_field(sbcs, DMI_SBCS_SBAUTOINCREMENT, 1);
+	bool setup_needed = true;
+	time_t start = time(NULL);
 
 	while (next_address < end_address) {
-		uint32_t sbcs = set_field(0, DMI_SBCS_SBREADONADDR, 1);
-		sbcs |= sb_sbaccess(size);
-		sbcs = set_field(sbcs, DMI_SBCS_SBAUTOINCREMENT, 1);
-		sbcs = set_field(sbcs, DMI_SBCS_SBREADONDATA, count > 1);
-		dmi_write(target, DMI_SBCS, sbcs);
-
-		/* This address write will trigger the first read. */
-		sb_write_address(target, next_address);
+		uint32_t first = (next_address - address) / size;
+		struct riscv_batch *batch = riscv_batch_alloc(target, SB_BATCH_SCANS,
+				info->dmi_busy_delay + info->bus_master_read_delay);
+
+		if (setup_needed) {
+			/* This address write will trigger the first read. */
+			riscv_batch_add_dmi_write(batch, DMI_SBCS, set_field(sbcs,
+						DMI_SBCS_SBREADONDATA, count - first > 1));
+			sb_batch_add_address(target, batch, next_address);
+		}
 
-		if (info->bus_master_read_delay) {
-			jtag_add_runtest(info->bus_master_read_delay, TAP_IDLE);
-			if (jtag_execute_queue() != ERROR_OK) {
-				LOG_ERROR("Failed to scan idle sequence");
-				return ERROR_FAIL;
-			}
+		uint32_t i;
+		for (i = first; i < count; i++) {
+			if (batch->used_scans + word_scans > SB_BATCH_SCANS)
+				break;
+			/* Don't let reading the last word start another bus access. */
+			if (i == count - 1 && !(setup_needed && i == first))
+				riscv_batch_add_dmi_write(batch, DMI_SBCS, sbcs);
+			for (unsigned j = sbdata_count; j-- > 0; )
+				riscv_batch_add_dmi_read(batch, DMI_SBDATA0 + j);
 		}
+		uint32_t words = i - first;
 
-		for (uint32_t i = (next_address - address) / size; i < count - 1; i++) {
-			read_memory_bus_word(target, address + i * size, size,
-					buffer + i * size);
+		int result = batch_run(target, batch);
+		if (result != ERROR_OK) {
+			riscv_batch_free(batch);
+			return result;
 		}
 
-		sbcs = set_field(sbcs, DMI_SBCS_SBREADONDATA, 0);
-		dmi_write(target, DMI_SBCS, sbcs);
+		/* Collect the words whose reads all went through. */
+		uint32_t received = 0;
+		bool batch_busy = false;
+		for (uint32_t w = 0; w < words && !batch_busy; w++) {
+			target_addr_t word_address = next_address + w * size;
+			uint8_t *p = buffer + (first + w) * size;
+			size_t key = w * sbdata_count;
+			for (unsigned j = sbdata_count; j-- > 0; key++) {
+				uint64_t dmi_out = riscv_batch_get_dmi_read(batch, key);
+				if (get_field(dmi_out, DTM_DMI_OP) != DMI_STATUS_SUCCESS) {
+					batch_busy = true;
+					break;
+				}
+				uint32_t value = get_field(dmi_out, DTM_DMI_DATA);
+				write_to_buf(p + 4 * j, value, MIN(size, 4));
+				log_memory_access(word_address + 4 * j, value, MIN(size, 4), true);
+			}
+			if (!batch_busy)
+				received++;
+		}
+		riscv_batch_free(batch);
 
-		read_memory_bus_word(target, address + (count - 1) * size, size,
-				buffer + (count - 1) * size);
+		uint32_t sbcs_read;
+		bool dmi_busy;
+		if (sb_batch_done(target, &sbcs_read, &dmi_busy) != ERROR_OK)
+			return ERROR_FAIL;
+		if (batch_busy && !dmi_busy)
+			increase_dmi_busy_delay(target);
 
-		if (read_sbcs_nonbusy(target, &sbcs) != ERROR_OK)
+		if (get_field(sbcs_read, DMI_SBCS_SBERROR)) {
+			/* Some error indicating the bus access failed, but not because of
+			 * something we did wrong. */
+			dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
 			return ERROR_FAIL;
+		}
+
+		if (!batch_busy && !dmi_busy &&
+				!get_field(sbcs_read, DMI_SBCS_SBBUSYERROR)) {
+			next_address += words * size;
+			setup_needed = false;
+			continue;
+		}
 
-		if (get_field(sbcs, DMI_SBCS_SBBUSYERROR)) {
+		if (get_field(sbcs_read, DMI_SBCS_SBBUSYERROR)) {
 			/* We read while the target was busy. Slow down and try again. */
 			dmi_write(target, DMI_SBCS, DMI_SBCS_SBBUSYERROR);
-			next_address = sb_read_address(target);
 			info->bus_master_read_delay += info->bus_master_read_delay / 10 + 1;
-			continue;
 		}
 
-		unsigned error = get_field(sbcs, DMI_SBCS_SBERROR);
-		if (error == 0) {
-			next_address = end_address;
-		} else {
-			/* Some error indicating the bus access failed, but not because of
-			 * something we did wrong. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
+		/* The bus access that completed last left its data in SBDATA, and
+		 * we may not have got it: read it again. */
+		target_addr_t sbaddress = sb_read_address(target);
+		target_addr_t retry_address = next_address + received * size;
+		if (sbaddress >= next_address + size && sbaddress - size < retry_address)
+			retry_address = sbaddress - size;
+		LOG_DEBUG("retrying system bus read at 0x%" TARGET_PRIxADDR, retry_address);
+		next_address = retry_address;
+		setup_needed = true;
+
+		if (time(NULL) - start > riscv_command_timeout_sec) {
+			LOG_ERROR("Timed out after %ds retrying system bus reads. "
+					"Increase the timeout with riscv set_command_timeout_sec.",
+					riscv_command_timeout_sec);
 			return ERROR_FAIL;
 		}
 	}
@@ -2071,21 +2230,6 @@ static int read_memory_bus_v1(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
-static int batch_run(const struct target *target, struct riscv_batch *batch)
-{
-	RISCV013_INFO(info);
-	RISCV_INFO(r);
-	if (r->reset_delays_wait >= 0) {
-		r->reset_delays_wait -= batch->used_scans;
-		if (r->reset_delays_wait <= 0) {
-			batch->idle_count = 0;
-			info->dmi_busy_delay = 0;
-			info->ac_busy_delay = 0;
-		}
-	}
-	return riscv_batch_run(batch);
-}
-
 /**
  * Read the requested memory, taking care to execute every read exactly once,
  * even if cmderr=busy is encountered.
@@ -2374,26 +2518,107 @@ static int read_memory_progbuf(struct target *target, target_addr_t address,
 	return result;
 }
 
-static int read_memory(struct target *target, target_addr_t address,
-		uint32_t size, uint32_t count, uint8_t *buffer)
+/* Transfers of at least this many bytes are timed, and may use whichever
+ * memory access method turned out faster. */
+#define MEM_BULK_BYTES		1024
+
+static bool sb_access_supported(struct target *target, uint32_t size)
 {
 	RISCV013_INFO(info);
-	if (info->progbufsize >= 2 && !riscv_prefer_sba)
-		return read_memory_progbuf(target, address, size, count, buffer);
-
-	if ((get_field(info->sbcs, DMI_SBCS_SBACCESS8) && size == 1) ||
+	if (get_field(info->sbcs, DMI_SBCS_SBVERSION) > 1)
+		return false;
+	return (get_field(info->sbcs, DMI_SBCS_SBACCESS8) && size == 1) ||
 			(get_field(info->sbcs, DMI_SBCS_SBACCESS16) && size == 2) ||
 			(get_field(info->sbcs, DMI_SBCS_SBACCESS32) && size == 4) ||
 			(get_field(info->sbcs, DMI_SBCS_SBACCESS64) && size == 8) ||
-			(get_field(info->sbcs, DMI_SBCS_SBACCESS128) && size == 16)) {
+			(get_field(info->sbcs, DMI_SBCS_SBACCESS128) && size == 16);
+}
+
+/*
+ * Pick the method for a transfer both the program buffer and system bus
+ * access can do. Unless "riscv set_mem_method auto" is in effect, that is
+ * the one picked by "riscv set_prefer_sba". Otherwise small transfers use
+ * the program buffer unless told to prefer SBA, and bulk ones use whichever
+ * was measured faster, after trying each of them; every 32nd bulk transfer
+ * retries the other one, in case the measurement was off.
+ */
+static mem_method_t mem_choose_method(struct target *target, bool write,
+		uint32_t bytes)
+{
+	RISCV013_INFO(info);
+	const unsigned int *rate = info->mem_rate[write];
+
+	if (riscv_prefer_sba)
+		return MEM_METHOD_SBA;
+	if (!riscv_mem_method_auto || bytes < MEM_BULK_BYTES)
+		return MEM_METHOD_PROGBUF;
+	if (rate[MEM_METHOD_PROGBUF] == 0)
+		return MEM_METHOD_PROGBUF;
+	if (rate[MEM_METHOD_SBA] == 0)
+		return MEM_METHOD_SBA;
+
+	mem_method_t faster = rate[MEM_METHOD_SBA] > rate[MEM_METHOD_PROGBUF] ?
+		MEM_METHOD_SBA : MEM_METHOD_PROGBUF;
+	if (++info->mem_transfers[write] % 32 == 0)
+		return faster == MEM_METHOD_SBA ? MEM_METHOD_PROGBUF : MEM_METHOD_SBA;
+	return faster;
+}
+
+static void mem_update_rate(struct target *target, bool write,
+		mem_method_t method, uint32_t bytes, int64_t start_ms)
+{
+	RISCV013_INFO(info);
+	unsigned int *rate = &info->mem_rate[write][method];
+
+	if (bytes < MEM_BULK_BYTES)
+		return;
+
+	int64_t elapsed = timeval_ms() - start_ms;
+	unsigned int sample = bytes / (elapsed > 0 ? elapsed : 1);
+	if (sample == 0)
+		sample = 1;
+	/* Smooth out the odd slow transfer. */
+	*rate = *rate ? (3 * *rate + sample) / 4 : sample;
+	LOG_DEBUG("%s %s: %u bytes/ms", write ? "write" : "read",
+			method == MEM_METHOD_SBA ? "sba" : "progbuf", *rate);
+}
+
+static int read_memory(struct target *target, target_addr_t address,
+		uint32_t size, uint32_t count, uint8_t *buffer)
+{
+	RISCV013_INFO(info);
+	bool progbuf = info->progbufsize >= 2;
+	bool sba = sb_access_supported(target, size) &&
+		!(progbuf && info->sba_failed[false]);
+
+	if (progbuf && sba &&
+			mem_choose_method(target, false, size * count) == MEM_METHOD_PROGBUF)
+		sba = false;
+
+	if (sba) {
+		int64_t start = timeval_ms();
+		int result;
 		if (get_field(info->sbcs, DMI_SBCS_SBVERSION) == 0)
-			return read_memory_bus_v0(target, address, size, count, buffer);
-		else if (get_field(info->sbcs, DMI_SBCS_SBVERSION) == 1)
-			return read_memory_bus_v1(target, address, size, count, buffer);
+			result = read_memory_bus_v0(target, address, size, count, buffer);
+		else
+			result = read_memory_bus_v1(target, address, size, count, buffer);
+		if (result == ERROR_OK) {
+			mem_update_rate(target, false, MEM_METHOD_SBA, size * count, start);
+			return result;
+		}
+		if (!progbuf)
+			return result;
+		LOG_WARNING("System bus read failed, using the program buffer from now on.");
+		info->sba_failed[false] = true;
 	}
 
-	if (info->progbufsize >= 2)
-		return read_memory_progbuf(target, address, size, count, buffer);
+	if (progbuf) {
+		int64_t start = timeval_ms();
+		int result = read_memory_progbuf(target, address, size, count, buffer);
+		if (result == ERROR_OK)
+			mem_update_rate(target, false, MEM_METHOD_PROGBUF, size * count, start);
+		return result;
+	}
 
 	LOG_ERROR("Don't know how to read memory on this target.");
 	return ERROR_FAIL;
@@ -2487,77 +2712,96 @@ static int write_memory_bus_v0(struct target *target, target_addr_t address,
 	return ERROR_OK;
 }
 
+/*
+ * Write memory using the system bus interface, queueing the SBDATA writes
+ * in batches with sbautoincrement set and checking sbcs once per batch.
+ */
 static int write_memory_bus_v1(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer)
 {
 	RISCV013_INFO(info);
 	uint32_t sbcs = sb_sbaccess(size);
 	sbcs = set_field(sbcs, DMI_SBCS_SBAUTOINCREMENT, 1);
-	dmi_write(target, DMI_SBCS, sbcs);
 
 	target_addr_t next_address = address;
 	target_addr_t end_address = address + count * size;
+	/* Words wider than 32 bits are written through SBDATA3..SBDATA0. */
+	unsigned sbdata_count = (size + 3) / 4;
+	bool setup_needed = true;
+	time_t start = time(NULL);
 
-	sb_write_address(target, next_address);
 	while (next_address < end_address) {
-		for (uint32_t i = (next_address - address) / size; i < count; i++) {
-			const uint8_t *p = buffer + i * size;
-			if (size > 12)
-				dmi_write(target, DMI_SBDATA3,
-						((uint32_t) p[12]) |
-						(((uint32_t) p[13]) << 8) |
-						(((uint32_t) p[14]) << 16) |
-						(((uint32_t) p[15]) << 24));
-			if (size > 8)
-				dmi_write(target, DMI_SBDATA2,
-						((uint32_t) p[8]) |
-						(((uint32_t) p[9]) << 8) |
-						(((uint32_t) p[10]) << 16) |
-						(((uint32_t) p[11]) << 24));
-			if (size > 4)
-				dmi_write(target, DMI_SBDATA1,
-						((uint32_t) p[4]) |
-						(((uint32_t) p[5]) << 8) |
-						(((uint32_t) p[6]) << 16) |
-						(((uint32_t) p[7]) << 24));
-			uint32_t value = p[0];
-			if (size > 2) {
-				value |= ((uint32_t) p[2]) << 16;
-				value |= ((uint32_t) p[3]) << 24;
-			}
-			if (size > 1)
-				value |= ((uint32_t) p[1]) << 8;
-			dmi_write(target, DMI_SBDATA0, value);
+		uint32_t first = (next_address - address) / size;
+		struct riscv_batch *batch = riscv_batch_alloc(target, SB_BATCH_SCANS,
+				info->dmi_busy_delay + info->bus_master_write_delay);
 
-			log_memory_access(address + i * size, value, size, false);
+		if (setup_needed) {
+			riscv_batch_add_dmi_write(batch, DMI_SBCS, sbcs);
+			sb_batch_add_address(target, batch, next_address);
+		}
 
-			if (info->bus_master_write_delay) {
-				jtag_add_runtest(info->bus_master_write_delay, TAP_IDLE);
-				if (jtag_execute_queue() != ERROR_OK) {
-					LOG_ERROR("Failed to scan idle sequence");
-					return ERROR_FAIL;
+		uint32_t i;
+		for (i = first; i < count; i++) {
+			if (batch->used_scans + sbdata_count > SB_BATCH_SCANS)
+				break;
+			const uint8_t *p = buffer + i * size;
+			/* Writing SBDATA0 starts the bus access, so it goes last. */
+			for (unsigned j = sbdata_count; j-- > 0; ) {
+				const uint8_t *q = p + 4 * j;
+				uint32_t value = q[0];
+				if (size > 2) {
+					value |= ((uint32_t) q[2]) << 16;
+					value |= ((uint32_t) q[3]) << 24;
 				}
+				if (size > 1)
+					value |= ((uint32_t) q[1]) << 8;
+				riscv_batch_add_dmi_write(batch, DMI_SBDATA0 + j, value);
+				log_memory_access(address + i * size + 4 * j, value,
+						MIN(size, 4), false);
 			}
 		}
 
-		if (read_sbcs_nonbusy(target, &sbcs) != ERROR_OK)
+		int result = batch_run(target, batch);
+		riscv_batch_free(batch);
+		if (result != ERROR_OK)
+			return result;
+
+		uint32_t sbcs_read;
+		bool dmi_busy;
+		if (sb_batch_done(target, &sbcs_read, &dmi_busy) != ERROR_OK)
+			return ERROR_FAIL;
+
+		if (get_field(sbcs_read, DMI_SBCS_SBERROR)) {
+			/* Some error indicating the bus access failed, but not because of
+			 * something we did wrong. */
+			dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
 			return ERROR_FAIL;
+		}
 
-		if (get_field(sbcs, DMI_SBCS_SBBUSYERROR)) {
+		if (!dmi_busy && !get_field(sbcs_read, DMI_SBCS_SBBUSYERROR)) {
+			next_address = address + i * size;
+			setup_needed = false;
+			continue;
+		}
+
+		if (get_field(sbcs_read, DMI_SBCS_SBBUSYERROR)) {
 			/* We wrote while the target was busy. Slow down and try again. */
 			dmi_write(target, DMI_SBCS, DMI_SBCS_SBBUSYERROR);
-			next_address = sb_read_address(target);
 			info->bus_master_write_delay += info->bus_master_write_delay / 10 + 1;
-			continue;
 		}
 
-		unsigned error = get_field(sbcs, DMI_SBCS_SBERROR);
-		if (error == 0) {
-			next_address = end_address;
-		} else {
-			/* Some error indicating the bus access failed, but not because of
-			 * something we did wrong. */
-			dmi_write(target, DMI_SBCS, DMI_SBCS_SBERROR);
+		/* sbaddress points at the first word that wasn't written, unless the
+		 * batch was dropped before it got to set the address. */
+		target_addr_t sbaddress = sb_read_address(target);
+		if (sbaddress > next_address && sbaddress <= address + i * size)
+			next_address = sbaddress;
+		LOG_DEBUG("retrying system bus write at 0x%" TARGET_PRIxADDR, next_address);
+		setup_needed = true;
+
+		if (time(NULL) - start > riscv_command_timeout_sec) {
+			LOG_ERROR("Timed out after %ds retrying system bus writes. "
+					"Increase the timeout with riscv set_command_timeout_sec.",
+					riscv_command_timeout_sec);
 			return ERROR_FAIL;
 		}
 	}
@@ -2751,22 +2995,38 @@ static int write_memory(struct target *target, target_addr_t address,
 		uint32_t size, uint32_t count, const uint8_t *buffer)
 {
 	RISCV013_INFO(info);
-	if (info->progbufsize >= 2 && !riscv_prefer_sba)
-		return write_memory_progbuf(target, address, size, count, buffer);
+	bool progbuf = info->progbufsize >= 2;
+	bool sba = sb_access_supported(target, size) &&
+		!(progbuf && info->sba_failed[true]);
 
-	if ((get_field(info->sbcs, DMI_SBCS_SBACCESS8) && size == 1) ||
-			(get_field(info->sbcs, DMI_SBCS_SBACCESS16) && size == 2) ||
-			(get_field(info->sbcs, DMI_SBCS_SBACCESS32) && size == 4) ||
-			(get_field(info->sbcs, DMI_SBCS_SBACCESS64) && size == 8) ||
-			(get_field(info->sbcs, DMI_SBCS_SBACCESS128) && size == 16)) {
+	if (progbuf && sba &&
+			mem_choose_method(target, true, size * count) == MEM_METHOD_PROGBUF)
+		sba = false;
+
+	if (sba) {
+		int64_t start = timeval_ms();
+		int result;
 		if (get_field(info->sbcs, DMI_SBCS_SBVERSION) == 0)
-			return write_memory_bus_v0(target, address, size, count, buffer);
-		else if (get_field(info->sbcs, DMI_SBCS_SBVERSION) == 1)
-			return write_memory_bus_v1(target, address, size, count, buffer);
+			result = write_memory_bus_v0(target, address, size, count, buffer);
+		else
+			result = write_memory_bus_v1(target, address, size, count, buffer);
+		if (result == ERROR_OK) {
+			mem_update_rate(target, true, MEM_METHOD_SBA, size * count, start);
+			return result;
+		}
+		if (!progbuf)
+			return result;
+		LOG_WARNING("System bus write failed, using the program buffer from now on.");
+		info->sba_failed[true] = true;
 	}
 
-	if (info->progbufsize >= 2)
-		return write_memory_progbuf(target, address, size, count, buffer);
+	if (progbuf) {
+		int64_t start = timeval_ms();
+		int result = write_memory_progbuf(target, address, size, count, buffer);
+		if (result == ERROR_OK)
+			mem_update_rate(target, true, MEM_METHOD_PROGBUF, size * count, start);
+		return result;
+	}
 
 	LOG_ERROR("Don't know how to write memory on this target.");
 	return ERROR_FAIL;
@@ -2823,6 +3083,67 @@ static int riscv013_get_register(struct target *target,
 	return result;
 }
 
+/* Read x1..x31 with one abstract command and one or two data reads per
+ * register, all in a single batch. Any error leaves the caller to read the
+ * registers one at a time. */
+static int riscv013_get_gprs_bulk(struct target *target, riscv_reg_t *values)
+{
+	RISCV013_INFO(info);
+	unsigned xlen = riscv_xlen(target);
+	size_t keys[32][2];
+
+	/* one command write and up to two reads (two scans each) per register */
+	struct riscv_batch *batch = riscv_batch_alloc(target, 31 * 5,
+			info->dmi_busy_delay + info->ac_busy_delay);
+
+	for (unsigned i = 1; i < 32; i++) {
+		riscv_batch_add_dmi_write(batch, DMI_COMMAND,
+				access_register_command(target, GDB_REGNO_ZERO + i, xlen,
+					AC_ACCESS_REGISTER_TRANSFER));
+		keys[i][0] = riscv_batch_add_dmi_read(batch, DMI_DATA0);
+		if (xlen > 32)
+			keys[i][1] = riscv_batch_add_dmi_read(batch, DMI_DATA1);
+	}
+
+	if (batch_run(target, batch) != ERROR_OK) {
+		riscv_batch_free(batch);
+		return ERROR_FAIL;
+	}
+
+	uint32_t abstractcs;
+	if (wait_for_idle(target, &abstractcs) != ERROR_OK) {
+		riscv_batch_free(batch);
+		return ERROR_FAIL;
+	}
+	info->cmderr = get_field(abstractcs, DMI_ABSTRACTCS_CMDERR);
+	if (info->cmderr != CMDERR_NONE) {
+		LOG_DEBUG("bulk register read failed, abstractcs=0x%x", abstractcs);
+		if (info->cmderr == CMDERR_BUSY)
+			increase_ac_busy_delay(target);
+		riscv013_clear_abstract_error(target);
+		riscv_batch_free(batch);
+		return ERROR_FAIL;
+	}
+
+	values[0] = 0;
+	for (unsigned i = 1; i < 32; i++) {
+		values[i] = 0;
+		for (unsigned w = 0; w < (xlen > 32 ? 2 : 1); w++) {
+			uint64_t dmi_out = riscv_batch_get_dmi_read(batch, keys[i][w]);
+			dmi_status_t status = get_field(dmi_out, DTM_DMI_OP);
+			if (status != DMI_STATUS_SUCCESS) {
+				LOG_DEBUG("bulk register read got DMI status %d", status);
+				riscv_batch_free(batch);
+				return ERROR_FAIL;
+			}
+			values[i] |= (riscv_reg_t) get_field(dmi_out, DTM_DMI_DATA) << (32 * w);
+		}
+	}
+
+	riscv_batch_free(batch);
+	return ERROR_OK;
+}
+
 static int riscv013_set_register(struct target *target, int hid, int rid, uint64_t value)
 {
 	LOG_DEBUG("writing 0x%" PRIx64 " to register %s on hart %d", value,
@@ -2876,6 +3197,8 @@ static int riscv013_select_current_hart(struct target *target)
 static int riscv013_halt_current_hart(struct target *target)
 {
 	RISCV_INFO(r);
+	RISCV013_INFO(info);
+	unsigned int dmi_scans = info->dmi_scans;
 	LOG_DEBUG("halting hart %d", r->current_hartid);
 	if (riscv_is_halted(target))
 		LOG_ERROR("Hart %d is already halted!", r->current_hartid);
@@ -2906,6 +3229,9 @@ static int riscv013_halt_current_hart(struct target *target)
 	dmcontrol = set_field(dmcontrol, DMI_DMCONTROL_HALTREQ, 0);
 	dmi_write(target, DMI_DMCONTROL, dmcontrol);
 
+	LOG_DEBUG("halted hart %d using %u DMI scans", r->current_hartid,
+			info->dmi_scans - dmi_scans);
+
 	return ERROR_OK;
 }
 
@@ -2914,6 +3240,162 @@ static int riscv013_resume_current_hart(struct target *target)
 	return riscv013_step_or_resume_current_hart(target, false);
 }
 
+/*
+ * Select the harts in hart_mask (bit n is hart n of the DM) through the hart
+ * array mask, and return in *dmcontrol the DMCONTROL value addressing them.
+ * hartsel points at the lowest hart of the mask, which is selected as well.
+ * The caller must write *dmcontrol without DMI_DMCONTROL_HASEL when done.
+ */
+static int select_hart_array(struct target *target, uint64_t hart_mask,
+		uint32_t *dmcontrol)
+{
+	RISCV013_INFO(info);
+	dm013_info_t *dm = get_dm(target);
+
+	if (dm->hasel_supported != YNM_YES || hart_mask == 0)
+		return ERROR_FAIL;
+
+	/* Only touch the windows of harts hartsel can address at all, hawindowsel
+	 * is WARL. */
+	unsigned windows = MIN(HAWINDOW_COUNT,
+			((1ULL << info->hartsellen) + 31) / 32);
+	if (hart_mask >> (32 * windows))
+		return ERROR_FAIL;
+
+	for (unsigned w = 0; w < windows; w++) {
+		uint32_t window = hart_mask >> (32 * w);
+		if (dm->hawindow_valid && dm->hawindow[w] == window)
+			continue;
+		dm->hawindow_valid = false;
+		if (dmi_write(target, DMI_HAWINDOWSEL, w) != ERROR_OK)
+			return ERROR_FAIL;
+		if (dmi_write(target, DMI_HAWINDOW, window) != ERROR_OK)
+			return ERROR_FAIL;
+		dm->hawindow[w] = window;
+	}
+	for (unsigned w = windows; w < HAWINDOW_COUNT; w++)
+		dm->hawindow[w] = 0;
+	dm->hawindow_valid = true;
+
+	int first = 0;
+	while (!(hart_mask & (1ULL << first)))
+		first++;
+	*dmcontrol = set_hartsel(DMI_DMCONTROL_DMACTIVE | DMI_DMCONTROL_HASEL, first);
+	dm->current_hartid = first;
+
+	return ERROR_OK;
+}
+
+static int riscv013_halt_harts(struct target *target, uint64_t hart_mask)
+{
+	RISCV013_INFO(info);
+	unsigned int dmi_scans = info->dmi_scans;
+	uint32_t dmcontrol;
+	uint32_t dmstatus = 0;
+	bool halted = false;
+
+	if (select_hart_array(target, hart_mask, &dmcontrol) != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* Issue the halt command to all of them, and then wait for all to halt. */
+	int result = dmi_write(target, DMI_DMCONTROL, dmcontrol | DMI_DMCONTROL_HALTREQ);
+	for (size_t i = 0; result == ERROR_OK && i < 256; ++i) {
+		result = dmstatus_read(target, &dmstatus, true);
+		if (result == ERROR_OK && get_field(dmstatus, DMI_DMSTATUS_ALLHALTED)) {
+			halted = true;
+			break;
+		}
+	}
+
+	/* haltreq is per hart, clear it on every selected hart before
+	 * dropping the hart array from the selection. */
+	if (dmi_write(target, DMI_DMCONTROL, dmcontrol) != ERROR_OK)
+		return ERROR_FAIL;
+	if (dmi_write(target, DMI_DMCONTROL, dmcontrol & ~DMI_DMCONTROL_HASEL) != ERROR_OK)
+		return ERROR_FAIL;
+	if (result != ERROR_OK)
+		return result;
+
+	if (!halted) {
+		LOG_ERROR("unable to halt harts 0x%" PRIx64, hart_mask);
+		LOG_ERROR("  dmstatus =0x%08x", dmstatus);
+		return ERROR_FAIL;
+	}
+
+	LOG_DEBUG("halted harts 0x%" PRIx64 " using %u DMI scans", hart_mask,
+			info->dmi_scans - dmi_scans);
+
+	return ERROR_OK;
+}
+
+static int riscv013_resume_harts(struct target *target, uint64_t hart_mask)
+{
+	uint32_t dmcontrol;
+	uint32_t dmstatus = 0;
+	bool resumed = false;
+
+	if (select_hart_array(target, hart_mask, &dmcontrol) != ERROR_OK)
+		return ERROR_FAIL;
+
+	/* Issue the resume command to all of them, and then wait for all to
+	 * acknowledge it. */
+	int result = dmi_write(target, DMI_DMCONTROL, dmcontrol | DMI_DMCONTROL_RESUMEREQ);
+	for (size_t i = 0; result == ERROR_OK && i < 256; ++i) {
+		usleep(10);
+		result = dmstatus_read(target, &dmstatus, true);
+		if (result == ERROR_OK && get_field(dmstatus, DMI_DMSTATUS_ALLRESUMEACK)) {
+			resumed = true;
+			break;
+		}
+	}
+
+	if (dmi_write(target, DMI_DMCONTROL, dmcontrol & ~DMI_DMCONTROL_HASEL) != ERROR_OK)
+		return ERROR_FAIL;
+	if (result != ERROR_OK)
+		return result;
+
+	if (!resumed) {
+		LOG_ERROR("unable to resume harts 0x%" PRIx64, hart_mask);
+		LOG_ERROR("  dmstatus =0x%08x", dmstatus);
+		return ERROR_FAIL;
+	}
+
+	return ERROR_OK;
+}
+
+/*
+ * Read the aggregate halt state of the harts in hart_mask with a single
+ * DMSTATUS read. Fails if any of them needs individual attention (reset,
+ * unavailable, nonexistent), so that the caller looks at them one by one.
+ */
+static int riscv013_harts_halted(struct target *target, uint64_t hart_mask,
+		bool *any_halted, bool *all_halted)
+{
+	uint32_t dmcontrol;
+	uint32_t dmstatus;
+
+	if (select_hart_array(target, hart_mask, &dmcontrol) != ERROR_OK)
+		return ERROR_FAIL;
+
+	int result = dmi_write(target, DMI_DMCONTROL, dmcontrol);
+	if (result == ERROR_OK)
+		result = dmstatus_read(target, &dmstatus, true);
+	if (dmi_write(target, DMI_DMCONTROL, dmcontrol & ~DMI_DMCONTROL_HASEL) != ERROR_OK)
+		return ERROR_FAIL;
+	if (result != ERROR_OK)
+		return result;
+
+	if (get_field(dmstatus, DMI_DMSTATUS_ANYHAVERESET) ||
+			get_field(dmstatus, DMI_DMSTATUS_ANYUNAVAIL) ||
+			get_field(dmstatus, DMI_DMSTATUS_ANYNONEXISTENT))
+		return ERROR_FAIL;
+
+	*any_halted = get_field(dmstatus, DMI_DMSTATUS_ANYHALTED);
+	*all_halted = get_field(dmstatus, DMI_DMSTATUS_ALLHALTED);
+
+	return ERROR_OK;
+}
+
 static int riscv013_step_current_hart(struct target *target)
 {
 	return riscv013_step_or_resume_current_hart(target, true);
@@ -186,6 +186,7 @@ int riscv_command_timeout_sec = DEFAULT_COMMAND_TIMEOUT_SEC;
 int riscv_reset_timeout_sec = DEFAULT_RESET_TIMEOUT_SEC;
 
 bool riscv_prefer_sba;
+bool riscv_mem_method_auto;
 
 typedef struct {
 	uint16_t low, high;
@@ -275,6 +276,7 @@ static void riscv_free_registers(struct target *target)
 {
 	/* Free the shared structure use for most registers. */
 	if (target->reg_cache) {
+		register_cache_index_free(target->reg_cache);
 		if (target->reg_cache->reg_list) {
 			if (target->reg_cache->reg_list[0].arch_info)
 				free(target->reg_cache->reg_list[0].arch_info);
@@ -919,6 +921,45 @@ static int riscv_write_memory(struct target *target, target_addr_t address,
 	return tt->write_memory(target, address, size, count, buffer);
 }
 
+/* Fill the invalid GPRs of reg_list from a single batched read. Anything
+ * not covered is left invalid for register_get() to handle. */
+static int riscv_get_registers_bulk(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	RISCV_INFO(r);
+	riscv_reg_t values[32];
+	int needed = 0;
+
+	if (!r->get_gprs_bulk)
+		return ERROR_OK;
+
+	for (int i = 0; i < reg_list_size; i++) {
+		if (reg_list[i] && reg_list[i]->number <= GDB_REGNO_XPR31 &&
+				!reg_list[i]->valid)
+			needed++;
+	}
+	/* not worth a batch for a single register */
+	if (needed < 2)
+		return ERROR_OK;
+
+	if (riscv_select_current_hart(target) != ERROR_OK)
+		return ERROR_FAIL;
+
+	int result = r->get_gprs_bulk(target, values);
+	if (result != ERROR_OK)
+		return result;
+
+	for (int i = 0; i < reg_list_size; i++) {
+		struct reg *reg = reg_list[i];
+		if (!reg || reg->number > GDB_REGNO_XPR31 || reg->valid)
+			continue;
+		buf_set_u64(reg->value, 0, reg->size, values[reg->number]);
+		reg->valid = true;
+	}
+
+	return ERROR_OK;
+}
+
 static int riscv_get_gdb_reg_list_internal(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class, bool read)
@@ -951,6 +992,15 @@ static int riscv_get_gdb_reg_list_internal(struct target *target,
 	if (!*reg_list)
 		return ERROR_FAIL;
 
+	/* GPRs can only be read from a halted hart */
+	if (read && target->state == TARGET_HALTED) {
+		struct reg *gprs[32];
+		for (int i = 0; i < 32; i++)
+			gprs[i] = &target->reg_cache->reg_list[GDB_REGNO_ZERO + i];
+		if (riscv_get_registers_bulk(target, gprs, 32) != ERROR_OK)
+			LOG_DEBUG("bulk GPR read failed, reading one by one");
+	}
+
 	for (int i = 0; i < *reg_list_size; i++) {
 		assert(!target->reg_cache->reg_list[i].valid ||
 				target->reg_cache->reg_list[i].size > 0);
@@ -1189,12 +1239,82 @@ int set_debug_reason(struct target *target, int hartid)
 	return ERROR_OK;
 }
 
+/*
+ * Compute the mask of the harts controlled by target, or by its whole SMP
+ * group, for the hart array operations. Fails if there's no point or no way
+ * to use them: a single hart, or harts not behind the same debug module.
+ */
+static bool riscv_group_hart_mask(struct target *target, uint64_t *hart_mask)
+{
+	uint64_t mask = 0;
+
+	if (target->smp) {
+		for (struct target_list *list = target->head; list != NULL;
+				list = list->next) {
+			struct target *t = list->target;
+			int hartid = riscv_info(t)->current_hartid;
+			/* There's one debug module per TAP. */
+			if (t->tap != target->tap || hartid < 0 || hartid >= 64)
+				return false;
+			mask |= 1ULL << hartid;
+		}
+	} else if (riscv_rtos_enabled(target)) {
+		for (int i = 0; i < riscv_count_harts(target); ++i)
+			if (riscv_hart_enabled(target, i))
+				mask |= 1ULL << i;
+	}
+
+	if ((mask & (mask - 1)) == 0)
+		return false;
+
+	*hart_mask = mask;
+	return true;
+}
+
+/* Halt all harts of target, or of its SMP group, with one request. */
+static int riscv_halt_hart_array(struct target *target)
+{
+	riscv_info_t *r = riscv_info(target);
+	uint64_t hart_mask;
+
+	if (!r->halt_harts || !riscv_group_hart_mask(target, &hart_mask))
+		return ERROR_FAIL;
+
+	return r->halt_harts(target, hart_mask);
+}
+
+/*
+ * Use the aggregate halt state of the harts of target, or of its SMP group,
+ * to tell whether none of them changed state: they were all running and none
+ * halted, or they were all halted and still are.
+ */
+static bool riscv_harts_unchanged(struct target *target, bool were_halted)
+{
+	riscv_info_t *r = riscv_info(target);
+	uint64_t hart_mask;
+	bool any_halted, all_halted;
+
+	if (!r->harts_halted || !riscv_group_hart_mask(target, &hart_mask))
+		return false;
+	if (r->harts_halted(target, hart_mask, &any_halted, &all_halted) != ERROR_OK)
+		return false;
+
+	return were_halted ? all_halted : !any_halted;
+}
+
 /*** OpenOCD Interface ***/
 int riscv_openocd_poll(struct target *target)
 {
 	LOG_DEBUG("polling all harts");
 	int halted_hart = -1;
 	if (riscv_rtos_enabled(target)) {
+		/* Only look at the harts one by one if any of them changed. */
+		if ((target->state == TARGET_RUNNING || target->state == TARGET_HALTED) &&
+				riscv_harts_unchanged(target, target->state == TARGET_HALTED)) {
+			LOG_DEBUG("  no hart changed state, target->state=%d", target->state);
+			return ERROR_OK;
+		}
+
 		/* Check every hart for an event. */
 		for (int i = 0; i < riscv_count_harts(target); ++i) {
 			enum riscv_poll_hart out = riscv_poll_hart(target, i);
@@ -1221,13 +1341,30 @@ int riscv_openocd_poll(struct target *target)
 		 * halted (as we're either in single-step mode or they also
 		 * triggered a breakpoint), so don't attempt to halt those
 		 * harts. */
-		for (int i = 0; i < riscv_count_harts(target); ++i)
-			riscv_halt_one_hart(target, i);
+		if (riscv_halt_hart_array(target) == ERROR_OK)
+			register_cache_invalidate(target->reg_cache);
+		else
+			for (int i = 0; i < riscv_count_harts(target); ++i)
+				riscv_halt_one_hart(target, i);
 
 	} else if (target->smp) {
 		bool halt_discovered = false;
 		bool newly_halted[128] = {0};
 		unsigned i = 0;
+
+		/* Only look at the harts one by one if any of them changed. */
+		bool same_state = true;
+		for (struct target_list *list = target->head; list != NULL;
+				list = list->next)
+			if (list->target->state != target->state)
+				same_state = false;
+		if (same_state &&
+				(target->state == TARGET_RUNNING || target->state == TARGET_HALTED) &&
+				riscv_harts_unchanged(target, target->state == TARGET_HALTED)) {
+			LOG_DEBUG("  no hart changed state, target->state=%d", target->state);
+			return ERROR_OK;
+		}
+
 		for (struct target_list *list = target->head; list != NULL;
 				list = list->next, i++) {
 			struct target *t = list->target;
@@ -1254,13 +1391,16 @@ int riscv_openocd_poll(struct target *target)
 
 		if (halt_discovered) {
 			LOG_DEBUG("Halt other targets in this SMP group.");
+			bool array_halted = riscv_halt_hart_array(target) == ERROR_OK;
 			i = 0;
 			for (struct target_list *list = target->head; list != NULL;
 					list = list->next, i++) {
 				struct target *t = list->target;
 				riscv_info_t *r = riscv_info(t);
 				if (t->state != TARGET_HALTED) {
-					if (riscv_halt_one_hart(t, r->current_hartid) != ERROR_OK)
+					if (array_halted)
+						register_cache_invalidate(t->reg_cache);
+					else if (riscv_halt_one_hart(t, r->current_hartid) != ERROR_OK)
 						return ERROR_FAIL;
 					t->state = TARGET_HALTED;
 					if (set_debug_reason(t, r->current_hartid) != ERROR_OK)
@@ -1324,13 +1464,16 @@ int riscv_openocd_halt(struct target *target)
 
 	if (target->smp) {
 		LOG_DEBUG("Halt other targets in this SMP group.");
+		bool array_halted = riscv_halt_hart_array(target) == ERROR_OK;
 		struct target_list *targets = target->head;
 		result = ERROR_OK;
 		while (targets) {
 			struct target *t = targets->target;
 			targets = targets->next;
 			if (t->state != TARGET_HALTED) {
-				if (riscv_halt_all_harts(t) != ERROR_OK)
+				if (array_halted)
+					riscv_invalidate_register_cache(t);
+				else if (riscv_halt_all_harts(t) != ERROR_OK)
 					result = ERROR_FAIL;
 			}
 		}
@@ -1501,6 +1644,23 @@ COMMAND_HANDLER(riscv_set_prefer_sba)
 	return ERROR_OK;
 }
 
+COMMAND_HANDLER(riscv_set_mem_method)
+{
+	if (CMD_ARGC != 1) {
+		LOG_ERROR("Command takes exactly 1 parameter");
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+	if (strcmp(CMD_ARGV[0], "auto") == 0) {
+		riscv_mem_method_auto = true;
+	} else if (strcmp(CMD_ARGV[0], "fixed") == 0) {
+		riscv_mem_method_auto = false;
+	} else {
+		LOG_ERROR("Unknown memory access method selection: %s", CMD_ARGV[0]);
+		return ERROR_COMMAND_SYNTAX_ERROR;
+	}
+	return ERROR_OK;
+}
+
 void parse_error(const char *string, char c, unsigned position)
 {
 	char buf[position+2];
@@ -1807,6 +1967,15 @@ static const struct command_registration riscv_exec_command_handlers[] = {
 		.help = "When on, prefer to use System Bus Access to access memory. "
 			"When off, prefer to use the Program Buffer to access memory."
 	},
+	{
+		.name = "set_mem_method",
+		.handler = riscv_set_mem_method,
+		.mode = COMMAND_ANY,
+		.usage = "riscv set_mem_method auto|fixed",
+		.help = "When auto, transfers of 1 KiB or more use whichever of System "
+			"Bus Access and the Program Buffer is measured to be faster. "
+			"When fixed, always use the method picked by set_prefer_sba."
+	},
 	{
 		.name = "expose_csrs",
 		.handler = riscv_set_expose_csrs,
@@ -1947,6 +2116,7 @@ struct target_type riscv_target = {
 	.checksum_memory = riscv_checksum_memory,
 
 	.get_gdb_reg_list = riscv_get_gdb_reg_list,
+	.get_registers_bulk = riscv_get_registers_bulk,
 
 	.add_breakpoint = riscv_add_breakpoint,
 	.remove_breakpoint = riscv_remove_breakpoint,
@@ -1985,6 +2155,11 @@ void riscv_info_init(struct target *target, riscv_info_t *r)
 
 int riscv_halt_all_harts(struct target *target)
 {
+	if (!target->smp && riscv_halt_hart_array(target) == ERROR_OK) {
+		riscv_invalidate_register_cache(target);
+		return ERROR_OK;
+	}
+
 	for (int i = 0; i < riscv_count_harts(target); ++i) {
 		if (!riscv_hart_enabled(target, i))
 			continue;
@@ -2015,6 +2190,40 @@ int riscv_halt_one_hart(struct target *target, int hartid)
 
 int riscv_resume_all_harts(struct target *target)
 {
+	RISCV_INFO(r);
+	uint64_t hart_mask;
+
+	if (!target->smp && r->resume_harts &&
+			riscv_group_hart_mask(target, &hart_mask)) {
+		/* Prepare every halted hart, then let them all go at once. */
+		uint64_t resume_mask = 0;
+		for (int i = 0; i < riscv_count_harts(target); ++i) {
+			if (!(hart_mask & (1ULL << i)))
+				continue;
+			if (riscv_set_current_hartid(target, i) != ERROR_OK)
+				return ERROR_FAIL;
+			if (!riscv_is_halted(target)) {
+				LOG_DEBUG("  hart %d requested resume, but was already resumed", i);
+				continue;
+			}
+			r->on_resume(target);
+			resume_mask |= 1ULL << i;
+		}
+
+		if (resume_mask && r->resume_harts(target, resume_mask) != ERROR_OK) {
+			for (int i = 0; i < riscv_count_harts(target); ++i) {
+				if (!(resume_mask & (1ULL << i)))
+					continue;
+				if (riscv_set_current_hartid(target, i) != ERROR_OK)
+					return ERROR_FAIL;
+				r->resume_current_hart(target);
+			}
+		}
+
+		riscv_invalidate_register_cache(target);
+		return ERROR_OK;
+	}
+
 	for (int i = 0; i < riscv_count_harts(target); ++i) {
 		if (!riscv_hart_enabled(target, i))
 			continue;
@@ -104,6 +104,8 @@ typedef struct {
 	 * implementations. */
 	int (*get_register)(struct target *target,
 		riscv_reg_t *value, int hid, int rid);
+	/* Optional. Read x0..x31 of the current hart in one batch. */
+	int (*get_gprs_bulk)(struct target *target, riscv_reg_t *values);
 	int (*set_register)(struct target *, int hartid, int regid,
 			uint64_t value);
 	int (*select_current_hart)(struct target *);
@@ -111,6 +113,13 @@ typedef struct {
 	int (*halt_current_hart)(struct target *);
 	int (*resume_current_hart)(struct target *target);
 	int (*step_current_hart)(struct target *target);
+	/* Optional. Halt, resume or sample the harts in hart_mask (bit n is hart
+	 * n of the debug module of target) all at once. An error makes the caller
+	 * fall back to handling the harts one by one. */
+	int (*halt_harts)(struct target *target, uint64_t hart_mask);
+	int (*resume_harts)(struct target *target, uint64_t hart_mask);
+	int (*harts_halted)(struct target *target, uint64_t hart_mask,
+			bool *any_halted, bool *all_halted);
 	int (*on_halt)(struct target *target);
 	int (*on_resume)(struct target *target);
 	int (*on_step)(struct target *target);
@@ -143,6 +152,7 @@ extern int riscv_command_timeout_sec;
 extern int riscv_reset_timeout_sec;
 
 extern bool riscv_prefer_sba;
+extern bool riscv_mem_method_auto;
 
 /* Everything needs the RISC-V specific info structure, so here's a nice macro
  * that provides that. */
@@ -50,6 +50,7 @@
 
 #include <helper/binarybuffer.h>
 #include <helper/log.h>
+#include <helper/time_support.h>
 #include <sys/stat.h>
 
 static const int open_modeflags[12] = {
@@ -82,6 +83,12 @@ static void semihosting_set_field(struct target *target, uint64_t value,
 	size_t index,
 	uint8_t *fields);
 
+static void semihosting_console_flush(struct target *target);
+static void semihosting_console_put(struct target *target, const char *buf,
+	size_t len);
+static int semihosting_read_string(struct target *target, uint64_t addr,
+	bool to_console, size_t *len);
+
 /* Attempts to include gdb_server.h failed. */
 extern int gdb_actual_connections;
 
@@ -121,6 +128,10 @@ int semihosting_common_init(struct target *target, void *setup,
 	semihosting->result = -1;
 	semihosting->sys_errno = -1;
 	semihosting->cmdline = NULL;
+	semihosting->console_len = 0;
+	semihosting->console_timer_armed = false;
+	semihosting->call_count = 0;
+	semihosting->stats_start_ms = timeval_ms();
 
 	/* If possible, update it in setup(). */
 	semihosting->setup_time = clock();
@@ -136,6 +147,22 @@ int semihosting_common_init(struct target *target, void *setup,
 	return ERROR_OK;
 }
 
+/**
+ * Release the common semihosting data, writing out any console output
+ * still buffered on the host.
+ */
+void semihosting_common_destroy(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting)
+		return;
+
+	semihosting_console_flush(target);
+	free(semihosting->cmdline);
+	free(semihosting);
+	target->semihosting = NULL;
+}
+
 /**
  * Portable implementation of ARM semihosting calls.
  * Performs the currently pending semihosting operation
@@ -168,6 +195,17 @@ int semihosting_common(struct target *target)
 	LOG_DEBUG("op=0x%x, param=0x%" PRIx64, (int)semihosting->op,
 		semihosting->param);
 
+	semihosting->call_count++;
+
+	/*
+	 * Console writes are collected on the host and written in one go;
+	 * any other operation may interact with the console, so pending
+	 * output goes out first to preserve ordering.
+	 */
+	if (semihosting->op != SEMIHOSTING_SYS_WRITEC &&
+			semihosting->op != SEMIHOSTING_SYS_WRITE0)
+		semihosting_console_flush(target);
+
 	switch (semihosting->op) {
 
 		case SEMIHOSTING_SYS_CLOCK:	/* 0x10 */
@@ -1195,11 +1233,11 @@ int semihosting_common(struct target *target)
 				fileio_info->param_3 = 1;
 			} else {
 				uint64_t addr = semihosting->param;
-				unsigned char c;
-				retval = target_read_memory(target, addr, 1, 1, &c);
+				char c;
+				retval = target_read_memory(target, addr, 1, 1, (uint8_t *)&c);
 				if (retval != ERROR_OK)
 					return retval;
-				putchar(c);
+				semihosting_console_put(target, &c, 1);
 				semihosting->result = 0;
 			}
 			break;
@@ -1218,33 +1256,21 @@ int semihosting_common(struct target *target)
 			 * None. The RETURN REGISTER is corrupted.
 			 */
 			if (semihosting->is_fileio) {
-				size_t count = 0;
-				uint64_t addr = semihosting->param;
-				for (;; addr++) {
-					unsigned char c;
-					retval = target_read_memory(target, addr, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (c == '\0')
-						break;
-					count++;
-				}
+				size_t count;
+				retval = semihosting_read_string(target, semihosting->param,
+						false, &count);
+				if (retval != ERROR_OK)
+					return retval;
 				semihosting->hit_fileio = true;
 				fileio_info->identifier = "write";
 				fileio_info->param_1 = 1;
 				fileio_info->param_2 = semihosting->param;
 				fileio_info->param_3 = count;
 			} else {
-				uint64_t addr = semihosting->param;
-				do {
-					unsigned char c;
-					retval = target_read_memory(target, addr++, 1, 1, &c);
-					if (retval != ERROR_OK)
-						return retval;
-					if (!c)
-						break;
-					putchar(c);
-				} while (1);
+				retval = semihosting_read_string(target, semihosting->param,
+						true, NULL);
+				if (retval != ERROR_OK)
+					return retval;
 				semihosting->result = 0;
 			}
 			break;
@@ -1457,6 +1483,105 @@ static void semihosting_set_field(struct target *target, uint64_t value,
 		target_buffer_set_u32(target, fields + (index * 4), value);
 }
 
+static int semihosting_console_timer(void *priv)
+{
+	struct target *target = priv;
+
+	target->semihosting->console_timer_armed = false;
+	semihosting_console_flush(target);
+
+	return ERROR_OK;
+}
+
+/**
+ * Write the buffered console output to the host stdout.
+ */
+static void semihosting_console_flush(struct target *target)
+{
+	struct semihosting *semihosting = target->semihosting;
+
+	if (semihosting->console_timer_armed) {
+		target_unregister_timer_callback(semihosting_console_timer, target);
+		semihosting->console_timer_armed = false;
+	}
+
+	if (semihosting->console_len == 0)
+		return;
+
+	fwrite(semihosting->console_buf, 1, semihosting->console_len, stdout);
+	fflush(stdout);
+	semihosting->console_len = 0;
+}
+
+/**
+ * Queue console output from the target. The buffer is written out on a
+ * newline, when it fills up, before any non-console operation, or at the
+ * latest SEMIHOSTING_CONSOLE_FLUSH_MS after the first pending character.
+ */
+static void semihosting_console_put(struct target *target, const char *buf,
+	size_t len)
+{
+	struct semihosting *semihosting = target->semihosting;
+	bool newline = false;
+
+	while (len > 0) {
+		size_t n = MIN(len, sizeof(semihosting->console_buf) - semihosting->console_len);
+		memcpy(semihosting->console_buf + semihosting->console_len, buf, n);
+		if (memchr(buf, '\n', n))
+			newline = true;
+		semihosting->console_len += n;
+		buf += n;
+		len -= n;
+		if (semihosting->console_len == sizeof(semihosting->console_buf))
+			semihosting_console_flush(target);
+	}
+
+	if (newline)
+		semihosting_console_flush(target);
+	else if (semihosting->console_len > 0 && !semihosting->console_timer_armed) {
+		if (target_register_timer_callback(semihosting_console_timer,
+				SEMIHOSTING_CONSOLE_FLUSH_MS, TARGET_TIMER_TYPE_ONESHOT,
+				target) == ERROR_OK)
+			semihosting->console_timer_armed = true;
+		else
+			semihosting_console_flush(target);
+	}
+}
+
+/**
+ * Scan a null-terminated string in target memory, fetching it in chunks
+ * rather than one byte per access. Chunks end on a SEMIHOSTING_STRING_CHUNK
+ * boundary so the read never extends past the page holding the terminator.
+ * The characters are optionally forwarded to the console sink, and the
+ * string length (without terminator) is optionally returned.
+ */
+static int semihosting_read_string(struct target *target, uint64_t addr,
+	bool to_console, size_t *len)
+{
+	uint8_t chunk[SEMIHOSTING_STRING_CHUNK];
+	size_t count = 0;
+
+	for (;;) {
+		uint32_t size = SEMIHOSTING_STRING_CHUNK - (addr % SEMIHOSTING_STRING_CHUNK);
+		int retval = target_read_buffer(target, addr, size, chunk);
+		if (retval != ERROR_OK)
+			return retval;
+
+		uint8_t *end = memchr(chunk, '\0', size);
+		size_t n = end ? (size_t)(end - chunk) : size;
+		if (to_console)
+			semihosting_console_put(target, (const char *)chunk, n);
+		count += n;
+		if (end)
+			break;
+		addr += size;
+	}
+
+	if (len)
+		*len = count;
+	return ERROR_OK;
+}
+
 
 /* -------------------------------------------------------------------------
  * Common semihosting commands handlers. */
@@ -1493,6 +1618,9 @@ static __COMMAND_HANDLER(handle_common_semihosting_command)
 
 		/* FIXME never let that "catch" be dropped! (???) */
 		semihosting->is_active = is_active;
+
+		semihosting->call_count = 0;
+		semihosting->stats_start_ms = timeval_ms();
 	}
 
 	command_print(CMD, "semihosting is %s",
@@ -1595,6 +1723,38 @@ static __COMMAND_HANDLER(handle_common_semihosting_resumable_exit_command)
 	return ERROR_OK;
 }
 
+static __COMMAND_HANDLER(handle_common_semihosting_stats_command)
+{
+	struct target *target = get_current_target(CMD_CTX);
+
+	if (target == NULL) {
+		LOG_ERROR("No target selected");
+		return ERROR_FAIL;
+	}
+
+	struct semihosting *semihosting = target->semihosting;
+	if (!semihosting) {
+		command_print(CMD, "semihosting not supported for current target");
+		return ERROR_FAIL;
+	}
+
+	int64_t elapsed_ms = timeval_ms() - semihosting->stats_start_ms;
+
+	command_print(CMD, "%" PRIu64 " semihosting calls in %" PRId64 " ms"
+		" (%" PRIu64 " calls/s)",
+		semihosting->call_count, elapsed_ms,
+		elapsed_ms > 0 ? semihosting->call_count * 1000 / elapsed_ms : 0);
+
+	if (CMD_ARGC > 0) {
+		if (strcmp(CMD_ARGV[0], "reset"))
+			return ERROR_COMMAND_SYNTAX_ERROR;
+		semihosting->call_count = 0;
+		semihosting->stats_start_ms = timeval_ms();
+	}
+
+	return ERROR_OK;
+}
+
 const struct command_registration semihosting_common_handlers[] = {
 	{
 		"semihosting",
@@ -1624,5 +1784,12 @@ const struct command_registration semihosting_common_handlers[] = {
 		.usage = "['enable'|'disable']",
 		.help = "activate support for semihosting resumable exit",
 	},
+	{
+		"semihosting_stats",
+		.handler = handle_common_semihosting_stats_command,
+		.mode = COMMAND_EXEC,
+		.usage = "['reset']",
+		.help = "display the number of semihosting calls per second",
+	},
 	COMMAND_REGISTRATION_DONE
 };
@@ -88,6 +88,18 @@ enum semihosting_reported_exceptions {
 	ADP_STOPPED_RUN_TIME_ERROR = ((2 << 16) + 35),
 };
 
+/* Size of the host-side buffer collecting SYS_WRITEC/SYS_WRITE0 output. */
+#define SEMIHOSTING_CONSOLE_BUF_SIZE	256
+
+/* Pending console output is flushed at least this often (ms). */
+#define SEMIHOSTING_CONSOLE_FLUSH_MS	100
+
+/*
+ * SYS_WRITE0 strings are fetched in chunks that never cross an address
+ * aligned to this size, so reading past the terminator cannot fault.
+ */
+#define SEMIHOSTING_STRING_CHUNK	64
+
 struct target;
 
 /*
@@ -152,6 +164,19 @@ struct semihosting {
 	/** The current time when 'execution starts' */
 	clock_t setup_time;
 
+	/** Console output not yet written to the host stdout. */
+	char console_buf[SEMIHOSTING_CONSOLE_BUF_SIZE];
+	size_t console_len;
+
+	/** A flag reporting whether the console flush timer is pending. */
+	bool console_timer_armed;
+
+	/** Number of semihosting calls served since semihosting was enabled. */
+	uint64_t call_count;
+
+	/** Host time (ms) when call_count was last reset. */
+	int64_t stats_start_ms;
+
 	int (*setup)(struct target *target, int enable);
 	int (*post_result)(struct target *target);
 };
@@ -159,5 +184,6 @@ struct semihosting {
 int semihosting_common_init(struct target *target, void *setup,
 	void *post_result);
 int semihosting_common(struct target *target);
+void semihosting_common_destroy(struct target *target);
 
 #endif	/* OPENOCD_TARGET_SEMIHOSTING_COMMON_H */
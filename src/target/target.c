@@ -55,6 +55,7 @@
 #include "rtos/rtos.h"
 #include "transport/transport.h"
 #include "arm_cti.h"
+#include "semihosting_common.h"
 
 /* default halt wait timeout (ms) */
 #define DEFAULT_HALT_TIMEOUT 5000
@@ -159,6 +160,8 @@ static struct target_timer_callback *target_timer_callbacks;
 LIST_HEAD(target_reset_callback_list);
 LIST_HEAD(target_trace_callback_list);
 static const int polling_interval = 100;
+/* first polling interval after a resume, doubled while the target runs */
+static const int polling_interval_fast = 1;
 
 static const Jim_Nvp nvp_assert[] = {
 	{ .name = "assert", NVP_ASSERT },
@@ -613,6 +616,55 @@ int target_halt(struct target *target)
  * hand the infrastructure for running such helpers might use this
  * procedure but rely on hardware breakpoint to detect termination.)
  */
+static int handle_target(void *priv);
+
+/* make handle_target() run again within time_ms */
+static void target_poll_timer_update(unsigned int time_ms)
+{
+	struct timeval when;
+
+	gettimeofday(&when, NULL);
+	timeval_add_time(&when, 0, time_ms * 1000);
+
+	for (struct target_timer_callback *cb = target_timer_callbacks; cb; cb = cb->next) {
+		if (cb->callback != handle_target || cb->removed)
+			continue;
+		cb->time_ms = time_ms;
+		if (timeval_compare(&when, &cb->when) < 0)
+			cb->when = when;
+	}
+}
+
+int64_t target_poll_next_event(void)
+{
+	for (struct target_timer_callback *cb = target_timer_callbacks; cb; cb = cb->next) {
+		if (cb->callback == handle_target && !cb->removed)
+			return (int64_t)cb->when.tv_sec * 1000 + cb->when.tv_usec / 1000;
+	}
+
+	return INT64_MAX;
+}
+
+/* poll soon after a resume, a halt is most likely right after it */
+static void target_poll_fast(struct target *target)
+{
+	struct target_list *head = NULL;
+	int64_t now = timeval_ms();
+
+	if (target->smp)
+		head = target->head;
+
+	do {
+		struct target *curr = head ? head->target : target;
+
+		curr->poll_interval = polling_interval_fast;
+		curr->poll_next = now + polling_interval_fast;
+		head = head ? head->next : NULL;
+	} while (head);
+
+	target_poll_timer_update(polling_interval_fast);
+}
+
 int target_resume(struct target *target, int current, target_addr_t address,
 		int handle_breakpoints, int debug_execution)
 {
@@ -624,6 +676,11 @@ int target_resume(struct target *target, int current, target_addr_t address,
 		return ERROR_FAIL;
 	}
 
+	/* breakpoint changes still pending from gdb must be in place */
+	retval = breakpoint_batch_end(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_START);
 
 	/* note that resume *must* be asynchronous. The CPU can halt before
@@ -634,11 +691,23 @@ int target_resume(struct target *target, int current, target_addr_t address,
 	if (retval != ERROR_OK)
 		return retval;
 
+	target_poll_fast(target);
+
 	target_call_event_callbacks(target, TARGET_EVENT_RESUME_END);
 
 	return retval;
 }
 
+/* Software breakpoint changes deferred by gdb must be in target memory
+ * before anything else looks at or modifies that memory. */
+static int target_flush_breakpoint_batch(struct target *target)
+{
+	if (!target->breakpoint_batch)
+		return ERROR_OK;
+
+	return breakpoint_batch_end(target);
+}
+
 static int target_process_reset(struct command_invocation *cmd, enum target_reset_mode reset_mode)
 {
 	char buf[100];
@@ -651,8 +720,11 @@ static int target_process_reset(struct command_invocation *cmd, enum target_rese
 	}
 
 	struct target *target;
-	for (target = all_targets; target; target = target->next)
+	for (target = all_targets; target; target = target->next) {
+		/* don't leave deferred breakpoint changes behind across reset */
+		target_flush_breakpoint_batch(target);
 		target_call_reset_callbacks(target, reset_mode);
+	}
 
 	/* disable polling during reset to make reset event scripts
 	 * more predictable, i.e. dr/irscan & pathmove in events will
@@ -1100,6 +1172,9 @@ int target_read_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	int retval = target_flush_breakpoint_batch(target);
+	if (retval != ERROR_OK)
+		return retval;
 	return target->type->read_memory(target, address, size, count, buffer);
 }
 
@@ -1114,6 +1189,9 @@ int target_read_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support read_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	int retval = target_flush_breakpoint_batch(target);
+	if (retval != ERROR_OK)
+		return retval;
 	return target->type->read_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1128,6 +1206,9 @@ int target_write_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	int retval = target_flush_breakpoint_batch(target);
+	if (retval != ERROR_OK)
+		return retval;
 	return target->type->write_memory(target, address, size, count, buffer);
 }
 
@@ -1142,6 +1223,9 @@ int target_write_phys_memory(struct target *target,
 		LOG_ERROR("Target %s doesn't support write_phys_memory", target_name(target));
 		return ERROR_FAIL;
 	}
+	int retval = target_flush_breakpoint_batch(target);
+	if (retval != ERROR_OK)
+		return retval;
 	return target->type->write_phys_memory(target, address, size, count, buffer);
 }
 
@@ -1244,6 +1328,18 @@ int target_get_gdb_reg_list_noread(struct target *target,
 	return target_get_gdb_reg_list(target, reg_list, reg_list_size, reg_class);
 }
 
+int target_get_registers_bulk(struct target *target,
+		struct reg **reg_list, int reg_list_size)
+{
+	if (!target->type->get_registers_bulk)
+		return ERROR_OK;
+
+	if (target->state != TARGET_HALTED)
+		return ERROR_TARGET_NOT_HALTED;
+
+	return target->type->get_registers_bulk(target, reg_list, reg_list_size);
+}
+
 bool target_supports_gdb_connection(struct target *target)
 {
 	/*
@@ -1258,6 +1354,10 @@ int target_step(struct target *target,
 {
 	int retval;
 
+	retval = breakpoint_batch_end(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	target_call_event_callbacks(target, TARGET_EVENT_STEP_START);
 
 	retval = target->type->step(target, current, address, handle_breakpoints);
@@ -1323,8 +1423,6 @@ static void target_reset_examined(struct target *target)
 	target->examined = false;
 }
 
-static int handle_target(void *priv);
-
 static int target_init_one(struct command_context *cmd_ctx,
 		struct target *target)
 {
@@ -1729,6 +1827,10 @@ int target_call_timer_callbacks(void)
 /* invoke periodic callbacks immediately */
 int target_call_timer_callbacks_now(void)
 {
+	/* poll every target now, whatever its own polling interval says */
+	for (struct target *target = all_targets; target; target = target->next)
+		target->poll_next = 0;
+
 	return target_call_timer_callbacks_check_time(0);
 }
 
@@ -2032,8 +2134,7 @@ static void target_destroy(struct target *target)
 	if (target->type->deinit_target)
 		target->type->deinit_target(target);
 
-	if (target->semihosting)
-		free(target->semihosting);
+	semihosting_common_destroy(target);
 
 	jtag_unregister_event_callback(jtag_enable_callback, target);
 
@@ -2194,6 +2295,10 @@ int target_write_buffer(struct target *target, target_addr_t address, uint32_t s
 	if (size == 0)
 		return ERROR_OK;
 
+	int retval = target_flush_breakpoint_batch(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	if ((address + size - 1) < address) {
 		/* GDB can request this when e.g. PC is 0xfffffffc */
 		LOG_ERROR("address + size wrapped (" TARGET_ADDR_FMT ", 0x%08" PRIx32 ")",
@@ -2256,6 +2361,10 @@ int target_read_buffer(struct target *target, target_addr_t address, uint32_t si
 	if (size == 0)
 		return ERROR_OK;
 
+	int retval = target_flush_breakpoint_batch(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	if ((address + size - 1) < address) {
 		/* GDB can request this when e.g. PC is 0xfffffffc */
 		LOG_ERROR("address + size wrapped (" TARGET_ADDR_FMT ", 0x%08" PRIx32 ")",
@@ -2311,6 +2420,10 @@ int target_checksum_memory(struct target *target, target_addr_t address, uint32_
 		return ERROR_FAIL;
 	}
 
+	retval = target_flush_breakpoint_batch(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	retval = target->type->checksum_memory(target, address, size, &checksum);
 	if (retval != ERROR_OK) {
 		buffer = malloc(size);
@@ -2352,6 +2465,10 @@ int target_blank_check_memory(struct target *target,
 	if (target->type->blank_check_memory == NULL)
 		return ERROR_TARGET_RESOURCE_NOT_AVAILABLE;
 
+	int retval = target_flush_breakpoint_batch(target);
+	if (retval != ERROR_OK)
+		return retval;
+
 	return target->type->blank_check_memory(target, blocks, num_blocks, erased_value);
 }
 
@@ -2795,7 +2912,15 @@ static int handle_target(void *priv)
 
 	/* Poll targets for state changes unless that's globally disabled.
 	 * Skip targets that are currently disabled.
+	 *
+	 * Each target has its own polling interval: short right after a
+	 * resume, doubled on every poll while the target keeps running and
+	 * polling_interval otherwise. This callback runs as often as the
+	 * most urgent target needs it.
 	 */
+	int64_t now = timeval_ms();
+	int64_t next = now + polling_interval;
+
 	for (struct target *target = all_targets;
 			is_jtag_poll_safe() && target;
 			target = target->next) {
@@ -2806,6 +2931,23 @@ static int handle_target(void *priv)
 		if (!target->tap->enabled)
 			continue;
 
+		if (target->poll_next > now) {
+			if (target->poll_next < next)
+				next = target->poll_next;
+			continue;
+		}
+
+		if (target->state == TARGET_RUNNING || target->state == TARGET_DEBUG_RUNNING) {
+			target->poll_interval = MAX(target->poll_interval,
+					(unsigned int)polling_interval_fast) * 2;
+			if (target->poll_interval > (unsigned int)polling_interval)
+				target->poll_interval = polling_interval;
+		} else
+			target->poll_interval = polling_interval;
+		target->poll_next = now + target->poll_interval;
+		if (target->poll_next < next)
+			next = target->poll_next;
+
 		if (target->backoff.times > target->backoff.count) {
 			/* do not poll this time as we failed previously */
 			target->backoff.count++;
@@ -2848,6 +2990,8 @@ static int handle_target(void *priv)
 		}
 	}
 
+	target_poll_timer_update(next > now ? next - now : polling_interval_fast);
+
 	return retval;
 }
 
@@ -3420,7 +3564,8 @@ static COMMAND_HELPER(parse_load_image_command_CMD_ARGV, struct image *image,
 
 COMMAND_HANDLER(handle_load_image_command)
 {
-	uint8_t *buffer;
+	const uint8_t *buffer;
+	uint8_t *alloc;
 	size_t buf_cnt;
 	uint32_t image_size;
 	target_addr_t min_address = 0;
@@ -3444,20 +3589,9 @@ COMMAND_HANDLER(handle_load_image_command)
 	image_size = 0x0;
 	retval = ERROR_OK;
 	for (i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (buffer == NULL) {
-			command_print(CMD,
-						  "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
-			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_section_get(&image, i, &buffer, &alloc, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
 		uint32_t offset = 0;
 		uint32_t length = buf_cnt;
@@ -3479,7 +3613,7 @@ COMMAND_HANDLER(handle_load_image_command)
 			retval = target_write_buffer(target,
 					image.sections[i].base_address + offset, length, buffer + offset);
 			if (retval != ERROR_OK) {
-				free(buffer);
+				free(alloc);
 				break;
 			}
 			image_size += length;
@@ -3488,7 +3622,7 @@ COMMAND_HANDLER(handle_load_image_command)
 					image.sections[i].base_address + offset);
 		}
 
-		free(buffer);
+		free(alloc);
 	}
 
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
@@ -3503,6 +3637,65 @@ COMMAND_HANDLER(handle_load_image_command)
 
 }
 
+/* dump_image reads in chunks that grow while the adapter keeps up and
+ * shrink again when a single read stalls the server for too long */
+#define DUMP_IMAGE_MIN_CHUNK	4096
+#define DUMP_IMAGE_MAX_CHUNK	(1024 * 1024)
+#define DUMP_IMAGE_FAST_MS		100
+#define DUMP_IMAGE_SLOW_MS		500
+
+static bool dump_image_block_is_zero(const uint8_t *buf, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++)
+		if (buf[i])
+			return false;
+	return true;
+}
+
+/* Write len bytes at file offset *pos. In sparse mode all-zero
+ * DUMP_IMAGE_MIN_CHUNK blocks are skipped with a seek instead. */
+static int dump_image_write(struct fileio *fileio, const uint8_t *buf,
+		uint32_t len, size_t *pos, bool sparse, bool *hole)
+{
+	size_t size_written;
+	uint32_t start = 0;
+	int retval;
+
+	while (start < len) {
+		uint32_t end = len;
+
+		if (sparse) {
+			uint32_t block = MIN(len - start, DUMP_IMAGE_MIN_CHUNK);
+			if (dump_image_block_is_zero(buf + start, block)) {
+				start += block;
+				*pos += block;
+				*hole = true;
+				continue;
+			}
+			for (end = start + block; end < len; end += block) {
+				block = MIN(len - end, DUMP_IMAGE_MIN_CHUNK);
+				if (dump_image_block_is_zero(buf + end, block))
+					break;
+			}
+			if (*hole) {
+				retval = fileio_seek(fileio, *pos);
+				if (retval != ERROR_OK)
+					return retval;
+				*hole = false;
+			}
+		}
+
+		retval = fileio_write(fileio, end - start, buf + start, &size_written);
+		if (retval != ERROR_OK)
+			return retval;
+
+		*pos += end - start;
+		start = end;
+	}
+
+	return ERROR_OK;
+}
+
 COMMAND_HANDLER(handle_dump_image_command)
 {
 	struct fileio *fileio;
@@ -3511,14 +3704,19 @@ COMMAND_HANDLER(handle_dump_image_command)
 	target_addr_t address, size;
 	struct duration bench;
 	struct target *target = get_current_target(CMD_CTX);
+	bool sparse = false;
+	bool hole = false;
+	size_t pos = 0;
 
-	if (CMD_ARGC != 3)
+	if (CMD_ARGC == 4 && strcmp(CMD_ARGV[3], "sparse") == 0)
+		sparse = true;
+	else if (CMD_ARGC != 3)
 		return ERROR_COMMAND_SYNTAX_ERROR;
 
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[1], address);
 	COMMAND_PARSE_ADDRESS(CMD_ARGV[2], size);
 
-	uint32_t buf_size = (size > 4096) ? 4096 : size;
+	uint32_t buf_size = (size > DUMP_IMAGE_MAX_CHUNK) ? DUMP_IMAGE_MAX_CHUNK : size;
 	buffer = malloc(buf_size);
 	if (!buffer)
 		return ERROR_FAIL;
@@ -3531,19 +3729,36 @@ COMMAND_HANDLER(handle_dump_image_command)
 
 	duration_start(&bench);
 
+	uint32_t chunk = MIN(buf_size, DUMP_IMAGE_MIN_CHUNK);
 	while (size > 0) {
-		size_t size_written;
-		uint32_t this_run_size = (size > buf_size) ? buf_size : size;
+		uint32_t this_run_size = (size > chunk) ? chunk : size;
+		int64_t then = timeval_ms();
 		retval = target_read_buffer(target, address, this_run_size, buffer);
 		if (retval != ERROR_OK)
 			break;
 
-		retval = fileio_write(fileio, this_run_size, buffer, &size_written);
+		int64_t elapsed = timeval_ms() - then;
+		if (elapsed < DUMP_IMAGE_FAST_MS && chunk * 2 <= buf_size)
+			chunk *= 2;
+		else if (elapsed > DUMP_IMAGE_SLOW_MS && chunk > DUMP_IMAGE_MIN_CHUNK)
+			chunk /= 2;
+
+		retval = dump_image_write(fileio, buffer, this_run_size, &pos, sparse, &hole);
 		if (retval != ERROR_OK)
 			break;
 
 		size -= this_run_size;
 		address += this_run_size;
+		keep_alive();
+	}
+
+	/* a trailing hole still has to extend the file to its full size */
+	if (retval == ERROR_OK && hole) {
+		size_t size_written;
+		uint8_t zero = 0;
+		retval = fileio_seek(fileio, pos - 1);
+		if (retval == ERROR_OK)
+			retval = fileio_write(fileio, 1, &zero, &size_written);
 	}
 
 	free(buffer);
@@ -3573,7 +3788,8 @@ enum verify_mode {
 
 static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode verify)
 {
-	uint8_t *buffer;
+	const uint8_t *buffer;
+	uint8_t *alloc;
 	size_t buf_cnt;
 	uint32_t image_size;
 	int i;
@@ -3616,35 +3832,26 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 	int diffs = 0;
 	retval = ERROR_OK;
 	for (i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (buffer == NULL) {
-			command_print(CMD,
-					"error allocating buffer for section (%d bytes)",
-					(int)(image.sections[i].size));
-			break;
-		}
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
+		retval = image_section_get(&image, i, &buffer, &alloc, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
 
 		if (verify >= IMAGE_VERIFY) {
 			/* calculate checksum of image */
 			retval = image_calculate_checksum(buffer, buf_cnt, &checksum);
 			if (retval != ERROR_OK) {
-				free(buffer);
+				free(alloc);
 				break;
 			}
 
 			retval = target_checksum_memory(target, image.sections[i].base_address, buf_cnt, &mem_checksum);
 			if (retval != ERROR_OK) {
-				free(buffer);
+				free(alloc);
 				break;
 			}
 			if ((checksum != mem_checksum) && (verify == IMAGE_CHECKSUM_ONLY)) {
 				LOG_ERROR("checksum mismatch");
-				free(buffer);
+				free(alloc);
 				retval = ERROR_FAIL;
 				goto done;
 			}
@@ -3671,7 +3878,7 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 							if (diffs++ >= 127) {
 								command_print(CMD, "More than 128 errors, the rest are not printed.");
 								free(data);
-								free(buffer);
+								free(alloc);
 								goto done;
 							}
 						}
@@ -3686,7 +3893,7 @@ static COMMAND_HELPER(handle_verify_image_command_internal, enum verify_mode ver
 						  buf_cnt);
 		}
 
-		free(buffer);
+		free(alloc);
 		image_size += buf_cnt;
 	}
 	if (diffs > 0)
@@ -4557,6 +4764,250 @@ static int target_array2mem(Jim_Interp *interp, struct target *target,
 	return e;
 }
 
+/* read_memory/write_memory transfer through a buffer of this size */
+#define TARGET_JIM_MEMORY_CHUNK		(64 * 1024)
+
+/* Parse the "address width" prefix and the trailing "phys"/"-binary"
+ * options shared by read_memory and write_memory. */
+static int target_jim_memory_args(Jim_Interp *interp, int argc, Jim_Obj *const *argv,
+		int nfixed, target_addr_t *address, unsigned *width, bool *is_phys, bool *binary)
+{
+	jim_wide w;
+
+	if (Jim_GetWide(interp, argv[0], &w) != JIM_OK)
+		return JIM_ERR;
+	*address = w;
+
+	if (Jim_GetWide(interp, argv[1], &w) != JIM_OK)
+		return JIM_ERR;
+	switch (w) {
+		case 8:
+		case 16:
+		case 32:
+		case 64:
+			*width = w / 8;
+			break;
+		default:
+			Jim_SetResultString(interp, "invalid width, must be 8, 16, 32 or 64", -1);
+			return JIM_ERR;
+	}
+
+	if (*address & (*width - 1)) {
+		Jim_SetResultString(interp, "address is not aligned to width", -1);
+		return JIM_ERR;
+	}
+
+	*is_phys = false;
+	*binary = false;
+	for (int i = nfixed; i < argc; i++) {
+		const char *opt = Jim_GetString(argv[i], NULL);
+		if (!strcmp(opt, "phys"))
+			*is_phys = true;
+		else if (!strcmp(opt, "-binary"))
+			*binary = true;
+		else {
+			Jim_SetResultFormatted(interp, "unknown option \"%s\"", opt);
+			return JIM_ERR;
+		}
+	}
+
+	return JIM_OK;
+}
+
+/* Return target memory as a list of numbers or, with -binary, as a string
+ * holding the raw bytes in target order. */
+static int target_jim_read_memory(Jim_Interp *interp, struct target *target,
+		int argc, Jim_Obj *const *argv)
+{
+	target_addr_t address;
+	unsigned width;
+	bool is_phys, binary;
+	jim_wide count;
+
+	if (argc < 3 || argc > 5) {
+		Jim_WrongNumArgs(interp, 0, argv, "address width count ['phys'] ['-binary']");
+		return JIM_ERR;
+	}
+
+	if (target_jim_memory_args(interp, argc, argv, 3, &address, &width,
+				&is_phys, &binary) != JIM_OK)
+		return JIM_ERR;
+
+	if (Jim_GetWide(interp, argv[2], &count) != JIM_OK)
+		return JIM_ERR;
+	if (count <= 0 || (uint64_t)count > UINT32_MAX / width) {
+		Jim_SetResultString(interp, "invalid count", -1);
+		return JIM_ERR;
+	}
+
+	uint32_t total = count * width;
+	uint32_t buf_size = MIN(total, TARGET_JIM_MEMORY_CHUNK);
+	uint8_t *buffer = malloc(binary ? total : buf_size);
+	if (buffer == NULL)
+		return JIM_ERR;
+
+	Jim_Obj *result = binary ? NULL : Jim_NewListObj(interp, NULL, 0);
+	uint32_t offset = 0;
+	while (offset < total) {
+		uint32_t chunk = MIN(total - offset, buf_size);
+		uint8_t *dst = binary ? buffer + offset : buffer;
+		int retval;
+
+		if (is_phys)
+			retval = target_read_phys_memory(target, address + offset, width,
+					chunk / width, dst);
+		else
+			retval = target_read_memory(target, address + offset, width,
+					chunk / width, dst);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("read_memory: read at " TARGET_ADDR_FMT " failed",
+					address + offset);
+			Jim_SetResultString(interp, "read_memory: cannot read memory", -1);
+			if (result)
+				Jim_FreeNewObj(interp, result);
+			free(buffer);
+			return JIM_ERR;
+		}
+
+		for (uint32_t i = 0; result && i < chunk; i += width) {
+			uint64_t v;
+			switch (width) {
+				case 8:
+					v = target_buffer_get_u64(target, dst + i);
+					break;
+				case 4:
+					v = target_buffer_get_u32(target, dst + i);
+					break;
+				case 2:
+					v = target_buffer_get_u16(target, dst + i);
+					break;
+				default:
+					v = dst[i];
+					break;
+			}
+			Jim_ListAppendElement(interp, result, Jim_NewIntObj(interp, v));
+		}
+
+		offset += chunk;
+		keep_alive();
+	}
+
+	if (binary)
+		result = Jim_NewStringObj(interp, (const char *)buffer, total);
+	free(buffer);
+
+	Jim_SetResult(interp, result);
+	return JIM_OK;
+}
+
+/* Write a list of numbers or, with -binary, the raw bytes of a string */
+static int target_jim_write_memory(Jim_Interp *interp, struct target *target,
+		int argc, Jim_Obj *const *argv)
+{
+	target_addr_t address;
+	unsigned width;
+	bool is_phys, binary;
+	const uint8_t *data = NULL;
+	uint32_t total;
+
+	if (argc < 3 || argc > 5) {
+		Jim_WrongNumArgs(interp, 0, argv, "address width data ['phys'] ['-binary']");
+		return JIM_ERR;
+	}
+
+	if (target_jim_memory_args(interp, argc, argv, 3, &address, &width,
+				&is_phys, &binary) != JIM_OK)
+		return JIM_ERR;
+
+	if (binary) {
+		int len;
+		data = (const uint8_t *)Jim_GetString(argv[2], &len);
+		if (len % width) {
+			Jim_SetResultString(interp, "data length is not a multiple of width", -1);
+			return JIM_ERR;
+		}
+		total = len;
+	} else {
+		total = Jim_ListLength(interp, argv[2]) * width;
+	}
+
+	uint32_t buf_size = MIN(total, TARGET_JIM_MEMORY_CHUNK);
+	uint8_t *buffer = binary ? NULL : malloc(buf_size);
+	if (!binary && buffer == NULL && total)
+		return JIM_ERR;
+
+	int e = JIM_OK;
+	uint32_t offset = 0;
+	while (offset < total) {
+		uint32_t chunk = MIN(total - offset, binary ? TARGET_JIM_MEMORY_CHUNK : buf_size);
+		const uint8_t *src;
+		int retval;
+
+		if (binary) {
+			src = data + offset;
+		} else {
+			for (uint32_t i = 0; i < chunk; i += width) {
+				Jim_Obj *elem = Jim_ListGetIndex(interp, argv[2], (offset + i) / width);
+				jim_wide v;
+				if (Jim_GetWide(interp, elem, &v) != JIM_OK) {
+					e = JIM_ERR;
+					goto out;
+				}
+				switch (width) {
+					case 8:
+						target_buffer_set_u64(target, buffer + i, v);
+						break;
+					case 4:
+						target_buffer_set_u32(target, buffer + i, v);
+						break;
+					case 2:
+						target_buffer_set_u16(target, buffer + i, v);
+						break;
+					default:
+						buffer[i] = v;
+						break;
+				}
+			}
+			src = buffer;
+		}
+
+		if (is_phys)
+			retval = target_write_phys_memory(target, address + offset, width,
+					chunk / width, src);
+		else
+			retval = target_write_memory(target, address + offset, width,
+					chunk / width, src);
+		if (retval != ERROR_OK) {
+			LOG_ERROR("write_memory: write at " TARGET_ADDR_FMT " failed",
+					address + offset);
+			Jim_SetResultString(interp, "write_memory: cannot write memory", -1);
+			e = JIM_ERR;
+			goto out;
+		}
+
+		offset += chunk;
+		keep_alive();
+	}
+
+	Jim_SetEmptyResult(interp);
+
+out:
+	free(buffer);
+	return e;
+}
+
+static int jim_read_memory(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	struct target *target = get_current_target(current_command_context(interp));
+	return target_jim_read_memory(interp, target, argc - 1, argv + 1);
+}
+
+static int jim_write_memory(Jim_Interp *interp, int argc, Jim_Obj *const *argv)
+{
+	struct target *target = get_current_target(current_command_context(interp));
+	return target_jim_write_memory(interp, target, argc - 1, argv + 1);
+}
+
 /* FIX? should we propagate errors here rather than printing them
  * and continuing?
  */
@@ -4990,6 +5441,20 @@ static int jim_target_array2mem(Jim_Interp *interp,
 	return target_array2mem(interp, target, argc - 1, argv + 1);
 }
 
+static int jim_target_read_memory(Jim_Interp *interp,
+		int argc, Jim_Obj *const *argv)
+{
+	struct target *target = Jim_CmdPrivData(interp);
+	return target_jim_read_memory(interp, target, argc - 1, argv + 1);
+}
+
+static int jim_target_write_memory(Jim_Interp *interp,
+		int argc, Jim_Obj *const *argv)
+{
+	struct target *target = Jim_CmdPrivData(interp);
+	return target_jim_write_memory(interp, target, argc - 1, argv + 1);
+}
+
 static int jim_target_tap_disabled(Jim_Interp *interp)
 {
 	Jim_SetResultFormatted(interp, "[TAP is disabled]");
@@ -5325,6 +5790,22 @@ static const struct command_registration target_instance_command_handlers[] = {
 			"from target memory",
 		.usage = "arrayname bitwidth address count",
 	},
+	{
+		.name = "read_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_target_read_memory,
+		.help = "Read 8/16/32/64 bit memory as a list of numbers "
+			"or a binary string",
+		.usage = "address width count ['phys'] ['-binary']",
+	},
+	{
+		.name = "write_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_target_write_memory,
+		.help = "Write a list of numbers or a binary string "
+			"as 8/16/32/64 bit memory",
+		.usage = "address width data ['phys'] ['-binary']",
+	},
 	{
 		.name = "eventlist",
 		.handler = handle_target_event_list,
@@ -5498,6 +5979,7 @@ static int target_create(Jim_GetOptInfo *goi)
 	target->debug_reason        = DBG_REASON_UNDEFINED;
 	target->reg_cache           = NULL;
 	target->breakpoints         = NULL;
+	target->breakpoint_index    = NULL;
 	target->watchpoints         = NULL;
 	target->next                = NULL;
 	target->arch_info           = NULL;
@@ -5506,6 +5988,9 @@ static int target_create(Jim_GetOptInfo *goi)
 
 	target->halt_issued			= false;
 
+	target->poll_interval		= polling_interval;
+	target->poll_next			= 0;
+
 	/* initialize trace information */
 	target->trace_info = calloc(1, sizeof(struct trace));
 
@@ -5791,7 +6276,8 @@ static void free_fastload(void)
 
 COMMAND_HANDLER(handle_fast_load_image_command)
 {
-	uint8_t *buffer;
+	const uint8_t *buffer;
+	uint8_t *alloc;
 	size_t buf_cnt;
 	uint32_t image_size;
 	target_addr_t min_address = 0;
@@ -5823,19 +6309,9 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 	}
 	memset(fastload, 0, sizeof(struct FastLoad)*image.num_sections);
 	for (i = 0; i < image.num_sections; i++) {
-		buffer = malloc(image.sections[i].size);
-		if (buffer == NULL) {
-			command_print(CMD, "error allocating buffer for section (%d bytes)",
-						  (int)(image.sections[i].size));
-			retval = ERROR_FAIL;
+		retval = image_section_get(&image, i, &buffer, &alloc, &buf_cnt);
+		if (retval != ERROR_OK)
 			break;
-		}
-
-		retval = image_read_section(&image, i, 0x0, image.sections[i].size, buffer, &buf_cnt);
-		if (retval != ERROR_OK) {
-			free(buffer);
-			break;
-		}
 
 		uint32_t offset = 0;
 		uint32_t length = buf_cnt;
@@ -5856,7 +6332,7 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 			fastload[i].address = image.sections[i].base_address + offset;
 			fastload[i].data = malloc(length);
 			if (fastload[i].data == NULL) {
-				free(buffer);
+				free(alloc);
 				command_print(CMD, "error allocating buffer for section (%" PRIu32 " bytes)",
 							  length);
 				retval = ERROR_FAIL;
@@ -5871,7 +6347,7 @@ COMMAND_HANDLER(handle_fast_load_image_command)
 						  ((unsigned int)(image.sections[i].base_address + offset)));
 		}
 
-		free(buffer);
+		free(alloc);
 	}
 
 	if ((ERROR_OK == retval) && (duration_measure(&bench) == ERROR_OK)) {
@@ -6360,7 +6836,7 @@ static const struct command_registration target_exec_command_handlers[] = {
 		.name = "dump_image",
 		.handler = handle_dump_image_command,
 		.mode = COMMAND_EXEC,
-		.usage = "filename address size",
+		.usage = "filename address size ['sparse']",
 	},
 	{
 		.name = "verify_image_checksum",
@@ -6396,6 +6872,22 @@ static const struct command_registration target_exec_command_handlers[] = {
 			"and write the 8/16/32 bit values",
 		.usage = "arrayname bitwidth address count",
 	},
+	{
+		.name = "read_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_read_memory,
+		.help = "Read 8/16/32/64 bit memory as a list of numbers "
+			"or a binary string",
+		.usage = "address width count ['phys'] ['-binary']",
+	},
+	{
+		.name = "write_memory",
+		.mode = COMMAND_EXEC,
+		.jim_handler = jim_write_memory,
+		.help = "Write a list of numbers or a binary string "
+			"as 8/16/32/64 bit memory",
+		.usage = "address width data ['phys'] ['-binary']",
+	},
 	{
 		.name = "reset_nag",
 		.handler = handle_target_reset_nag,
@@ -171,6 +171,8 @@ struct target {
 	enum target_state state;			/* the current backend-state (running, halted, ...) */
 	struct reg_cache *reg_cache;		/* the first register cache of the target (core regs) */
 	struct breakpoint *breakpoints;		/* list of breakpoints */
+	struct breakpoint_index *breakpoint_index;	/* address index of breakpoints */
+	bool breakpoint_batch;			/* software breakpoint changes are deferred */
 	struct watchpoint *watchpoints;		/* list of watchpoints */
 	struct trace *trace_info;			/* generic trace information */
 	struct debug_msg_receiver *dbgmsg;	/* list of debug message receivers */
@@ -198,6 +200,8 @@ struct target {
 	bool rtos_auto_detect;				/* A flag that indicates that the RTOS has been specified as "auto"
 										 * and must be detected when symbols are offered */
 	struct backoff_timer backoff;
+	unsigned int poll_interval;			/* current adaptive polling interval in ms */
+	int64_t poll_next;					/* timeval_ms() at which to poll next */
 	int smp;							/* add some target attributes for smp support */
 	struct target_list *head;
 	/* the gdb service is there in case of smp, we have only one gdb server
@@ -403,6 +407,11 @@ int target_call_timer_callbacks(void);
  * a synchronous command completes.
  */
 int target_call_timer_callbacks_now(void);
+/**
+ * Returns the timeval_ms() time at which targets are polled next, so the
+ * server loop can wake up in time for it.
+ */
+int64_t target_poll_next_event(void);
 
 struct target *get_target_by_num(int num);
 struct target *get_current_target(struct command_context *cmd_ctx);
@@ -516,6 +525,15 @@ int target_get_gdb_reg_list_noread(struct target *target,
 		struct reg **reg_list[], int *reg_list_size,
 		enum target_register_class reg_class);
 
+/**
+ * Fetch the invalid registers of @a reg_list in bulk, where the target
+ * supports it.  Registers left invalid must be read individually.
+ *
+ * This routine is a wrapper for target->type->get_registers_bulk.
+ */
+int target_get_registers_bulk(struct target *target,
+		struct reg **reg_list, int reg_list_size);
+
 /**
  * Check if @a target allows GDB connections.
  *
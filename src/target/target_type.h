@@ -118,6 +118,16 @@ struct target_type {
 			struct reg **reg_list[], int *reg_list_size,
 			enum target_register_class reg_class);
 
+	/**
+	 * Optional. Fetch the values of the invalid registers in @a reg_list
+	 * in as few adapter transactions as possible and mark them valid.
+	 * Registers it cannot fetch are left invalid; callers read those
+	 * one by one.  Do @b not call this function directly, use
+	 * target_get_registers_bulk() instead.
+	 */
+	int (*get_registers_bulk)(struct target *target, struct reg **reg_list,
+			int reg_list_size);
+
 	/* target memory access
 	* size: 1 = byte (8bit), 2 = half-word (16bit), 4 = word (32bit)
 	* count: number of items of <size>
@@ -172,6 +182,15 @@ struct target_type {
 	 */
 	int (*remove_breakpoint)(struct target *target, struct breakpoint *breakpoint);
 
+	/**
+	 * Apply the software breakpoint changes deferred while
+	 * target->breakpoint_batch was set. Targets providing this may
+	 * leave software breakpoints unset in add_breakpoint() and only
+	 * remember the original instruction in remove_breakpoint() while
+	 * a batch is open.
+	 */
+	int (*flush_breakpoints)(struct target *target);
+
 	/* add watchpoint ... see add_breakpoint() comment above. */
 	int (*add_watchpoint)(struct target *target, struct watchpoint *watchpoint);
 
@@ -1286,6 +1286,7 @@ void x86_32_common_reset_breakpoints_watchpoints(struct target *t)
 	struct breakpoint *next_b;
 	struct watchpoint *next_w;
 
+	breakpoint_index_free(t);
 	while (t->breakpoints) {
 		next_b = t->breakpoints->next;
 		free(t->breakpoints->orig_instr);